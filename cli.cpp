@@ -0,0 +1,475 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Command line front end for batch work on many files, without the editor or Qt.
+
+#include "nbt/inflate.hpp"
+#include "nbt/io.hpp"
+#include "nbt/mapped_file.hpp"
+#include "nbt/parallel.hpp"
+#include "nbt/query.hpp"
+#include "nbt/validate.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+static const char USAGE[] = R"(usage: nbt-magic-cli [--jobs N] COMMAND ARGUMENTS...
+
+commands:
+  validate FILE...                    check that each file holds a well-formed named tag
+  decode FILE...                      print each file as SNBT
+  reencode [--compression none|gzip|zlib] [--output DIR] FILE...
+                                      decode each file and encode it again, over the original unless DIR is given,
+                                      keeping its compression unless another is asked for
+  query EXPRESSION FILE...            print every tag in each file that EXPRESSION matches, as SNBT
+
+Files are processed on up to N threads at once, one per core by default. Output still comes in the order the files
+were given, each file's as soon as every file before it is done. The exit status is 1 if any file failed and 2 if the
+arguments were wrong.
+)";
+
+// a command's output for one file, or what went wrong with it
+struct Outcome {
+	std::string output;
+	std::string error;
+};
+
+struct ReencodeOptions {
+	std::optional<nbt::Compression> compression; // the original file's if empty
+	std::optional<std::filesystem::path> output_directory; // in place if empty
+};
+
+static void write_snbt(std::string &out, const nbt::Tag &tag, int indent);
+
+static void write_number(std::string &out, auto value, std::string_view suffix) {
+	// SNBT has no way to write these, and anything else would be read back as a different value
+	if constexpr (std::is_floating_point_v<decltype(value)>) {
+		if (!std::isfinite(value))
+			throw std::domain_error("NaN and infinite numbers cannot be written as SNBT");
+	}
+
+	char buffer[32];
+	const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+	out.append(buffer, result.ptr);
+	out += suffix;
+}
+
+static bool is_bare_word(std::string_view text) {
+	if (text.empty())
+		return false;
+
+	for (const char c : text) {
+		const bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' ||
+			c == '-' || c == '.' || c == '+';
+		if (!allowed)
+			return false;
+	}
+
+	return true;
+}
+
+static void write_quoted(std::string &out, std::string_view text) {
+	out += '"';
+
+	for (const char c : text) {
+		switch (c) {
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\r':
+				out += "\\r";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				// any other control character would break the line or the terminal just the same
+				if (static_cast<unsigned char>(c) < 0x20) {
+					static constexpr char HEX[] = "0123456789abcdef";
+					out += "\\u00";
+					out += HEX[c >> 4];
+					out += HEX[c & 0xF];
+				} else {
+					out += c;
+				}
+		}
+	}
+
+	out += '"';
+}
+
+static void write_newline(std::string &out, int indent) {
+	if (indent < 0)
+		return;
+
+	out += '\n';
+	out.append(static_cast<size_t>(indent), '\t');
+}
+
+template <typename Array>
+static void write_array(std::string &out, std::string_view prefix, const Array &values, std::string_view suffix) {
+	out += '[';
+	out += prefix;
+	out += ';';
+
+	for (size_t i = 0; i < values.size(); ++i) {
+		out += i == 0 ? " " : ", ";
+		write_number(out, values[i], suffix);
+	}
+
+	out += ']';
+}
+
+// Appends tag as SNBT. A negative indent puts it all on one line; otherwise every list item and compound entry goes
+// on a line of its own, that many tabs in.
+static void write_snbt(std::string &out, const nbt::Tag &tag, int indent) {
+	const int inner = indent < 0 ? indent : indent + 1;
+
+	switch (tag.type()) {
+		case nbt::TagType::BYTE:
+			write_number(out, static_cast<int>(tag.byte_value()), "b");
+			break;
+		case nbt::TagType::SHORT:
+			write_number(out, tag.short_value(), "s");
+			break;
+		case nbt::TagType::INT:
+			write_number(out, tag.int_value(), "");
+			break;
+		case nbt::TagType::LONG:
+			write_number(out, tag.long_value(), "L");
+			break;
+		case nbt::TagType::FLOAT:
+			write_number(out, tag.float_value(), "f");
+			break;
+		case nbt::TagType::DOUBLE:
+			write_number(out, tag.double_value(), "d");
+			break;
+		case nbt::TagType::BYTE_ARRAY:
+			write_array(out, "B", tag.byte_array_value(), "b");
+			break;
+		case nbt::TagType::STRING:
+			write_quoted(out, tag.string_text());
+			break;
+		case nbt::TagType::LIST: {
+			const nbt::List &items = tag.list_value();
+
+			out += '[';
+			for (size_t i = 0; i < items.size(); ++i) {
+				if (i != 0)
+					out += indent < 0 ? ", " : ",";
+
+				write_newline(out, inner);
+				write_snbt(out, items[i], inner);
+			}
+
+			if (!items.empty())
+				write_newline(out, indent);
+			out += ']';
+			break;
+		}
+		case nbt::TagType::COMPOUND: {
+			const nbt::Compound &entries = tag.compound_value();
+
+			out += '{';
+			for (size_t i = 0; i < entries.size(); ++i) {
+				if (i != 0)
+					out += indent < 0 ? ", " : ",";
+
+				write_newline(out, inner);
+				if (is_bare_word(entries[i].name.str()))
+					out += entries[i].name.str();
+				else
+					write_quoted(out, entries[i].name.str());
+
+				out += ": ";
+				write_snbt(out, entries[i].tag, inner);
+			}
+
+			if (!entries.empty())
+				write_newline(out, indent);
+			out += '}';
+			break;
+		}
+		case nbt::TagType::INT_ARRAY:
+			write_array(out, "I", tag.int_array_value(), "");
+			break;
+		case nbt::TagType::LONG_ARRAY:
+			write_array(out, "L", tag.long_array_value(), "L");
+			break;
+		default:
+			break;
+	}
+}
+
+// the file's bytes as a decoder sees them, inflated if need be
+static std::vector<std::byte> inflated_contents(std::span<const std::byte> data, nbt::Compression compression) {
+	if (compression == nbt::Compression::NONE)
+		return {data.begin(), data.end()};
+
+	nbt::SpanSource source(data);
+	return nbt::inflate_all(source, compression);
+}
+
+static std::string validate_file(const std::filesystem::path &path) {
+	const nbt::MappedFile file(path);
+	const nbt::Compression compression = nbt::detect_compression(file.data());
+
+	// uncompressed files are validated straight out of the mapping
+	std::vector<std::byte> inflated;
+	std::span<const std::byte> data = file.data();
+	if (compression != nbt::Compression::NONE) {
+		inflated = inflated_contents(data, compression);
+		data = inflated;
+	}
+
+	const nbt::ValidationResult result = nbt::validate(data);
+	if (!result.valid)
+		throw nbt::IOError(std::string(result.error) + " at offset " + std::to_string(result.offset));
+
+	return path.string() + ": ok, " + std::to_string(result.tag_count) + " tags\n";
+}
+
+static std::string decode_file(const std::filesystem::path &path) {
+	const nbt::NamedTag tag = nbt::read_named_binary(path);
+
+	std::string out = path.string() + ": ";
+	if (is_bare_word(tag.name.str()))
+		out += tag.name.str();
+	else
+		write_quoted(out, tag.name.str());
+
+	out += ": ";
+	write_snbt(out, tag.tag, 0);
+	out += '\n';
+	return out;
+}
+
+// where reencoding path writes to
+static std::filesystem::path reencode_target(const std::filesystem::path &path, const ReencodeOptions &options) {
+	return options.output_directory ? *options.output_directory / path.filename() : path;
+}
+
+static std::string reencode_file(const std::filesystem::path &path, const ReencodeOptions &options) {
+	std::ostringstream encoded;
+	nbt::Compression compression;
+
+	{
+		const nbt::MappedFile file(path);
+		compression = options.compression.value_or(nbt::detect_compression(file.data()));
+		nbt::write_named_binary(encoded, nbt::read_named_binary(file.data()));
+		// the mapping has to go before the file can be replaced on every platform
+	}
+
+	const std::string &bytes = encoded.str();
+	const std::vector<std::byte> output = nbt::deflate_all(
+		{reinterpret_cast<const std::byte *>(bytes.data()), bytes.size()}, compression);
+
+	const std::filesystem::path target = reencode_target(path, options);
+	// written beside the target first, so that a failure never leaves it half written
+	std::filesystem::path temporary = target;
+	temporary += ".tmp";
+
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(output.data()), static_cast<std::streamsize>(output.size()));
+		file.close();
+		if (!file)
+			throw nbt::IOError("Could not write " + temporary.string());
+	}
+
+	std::filesystem::rename(temporary, target);
+	return path.string() + " -> " + target.string() + ": " + std::to_string(output.size()) + " bytes\n";
+}
+
+static std::string query_file(const std::filesystem::path &path, const nbt::Query &query) {
+	std::string out;
+
+	for (const nbt::Tag &match : nbt::query_named_binary(path, query)) {
+		out += path.string() + ": ";
+		write_snbt(out, match, -1);
+		out += '\n';
+	}
+
+	return out;
+}
+
+static std::optional<nbt::Compression> parse_compression(std::string_view name) {
+	if (name == "none")
+		return nbt::Compression::NONE;
+	if (name == "gzip")
+		return nbt::Compression::GZIP;
+	if (name == "zlib")
+		return nbt::Compression::ZLIB;
+
+	return std::nullopt;
+}
+
+static int usage_error(std::string_view message) {
+	std::cerr << "nbt-magic-cli: " << message << "\n\n" << USAGE;
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	const std::vector<std::string_view> arguments(argv + 1, argv + argc);
+	size_t next = 0;
+
+	const auto take = [&]() -> std::optional<std::string_view> {
+		if (next == arguments.size())
+			return std::nullopt;
+
+		return arguments[next++];
+	};
+
+	int jobs = nbt::default_thread_count();
+	if (next < arguments.size() && arguments[next] == "--jobs") {
+		++next;
+		const std::optional<std::string_view> count = take();
+		if (!count)
+			return usage_error("--jobs needs a number");
+
+		const auto result = std::from_chars(count->data(), count->data() + count->size(), jobs);
+		if (result.ec != std::errc() || result.ptr != count->data() + count->size() || jobs <= 0)
+			return usage_error("--jobs needs a positive number");
+	}
+
+	const std::optional<std::string_view> command = take();
+	if (!command)
+		return usage_error("no command given");
+
+	ReencodeOptions reencode_options;
+	std::optional<nbt::Query> query;
+
+	if (*command == "reencode") {
+		while (next < arguments.size() && arguments[next].starts_with("--")) {
+			const std::string_view option = arguments[next++];
+			const std::optional<std::string_view> value = take();
+			if (!value)
+				return usage_error(std::string(option) + " needs a value");
+
+			if (option == "--compression") {
+				reencode_options.compression = parse_compression(*value);
+				if (!reencode_options.compression)
+					return usage_error("unknown compression " + std::string(*value));
+			} else if (option == "--output") {
+				reencode_options.output_directory = std::filesystem::path(*value);
+			} else {
+				return usage_error("unknown option " + std::string(option));
+			}
+		}
+	} else if (*command == "query") {
+		const std::optional<std::string_view> expression = take();
+		if (!expression)
+			return usage_error("query needs an expression");
+
+		try {
+			query.emplace(*expression);
+		} catch (const nbt::QueryError &error) {
+			return usage_error(error.what());
+		}
+	} else if (*command != "validate" && *command != "decode") {
+		return usage_error("unknown command " + std::string(*command));
+	}
+
+	const std::vector<std::filesystem::path> files(arguments.begin() + static_cast<ptrdiff_t>(next), arguments.end());
+	if (files.empty())
+		return usage_error("no files given");
+
+	// Two files written to the same place would race on it, and one would silently replace the other, so only the
+	// first of them is reencoded and the rest fail before anything is read.
+	std::vector<std::string> refused(files.size());
+	if (*command == "reencode") {
+		std::map<std::filesystem::path, size_t> claimed;
+		for (size_t i = 0; i < files.size(); ++i) {
+			const std::filesystem::path target =
+				std::filesystem::absolute(reencode_target(files[i], reencode_options)).lexically_normal();
+			const auto [first, added] = claimed.try_emplace(target, i);
+			if (!added)
+				refused[i] = "would be written to " + target.string() + ", as " + files[first->second].string() + " is";
+		}
+	}
+
+	// Outcomes wait here until every file before theirs has been printed, then go out and are freed at once, so
+	// output keeps up with the work and only files finished out of turn are held.
+	std::vector<std::optional<Outcome>> waiting(files.size());
+	std::mutex print_mutex;
+	size_t next_to_print = 0;
+	bool failed = false;
+
+	const auto finish = [&](size_t i, Outcome outcome) {
+		const std::lock_guard lock(print_mutex);
+		waiting[i] = std::move(outcome);
+
+		for (; next_to_print < files.size() && waiting[next_to_print].has_value(); ++next_to_print) {
+			const Outcome &ready = *waiting[next_to_print];
+			std::cout << ready.output << std::flush;
+
+			if (!ready.error.empty()) {
+				std::cerr << files[next_to_print].string() << ": " << ready.error << '\n';
+				failed = true;
+			}
+
+			waiting[next_to_print].reset();
+		}
+	};
+
+	nbt::parallel_for(files.size(), jobs, [&](size_t i) {
+		// every failure is kept for its own file, so one bad file never stops the rest
+		Outcome outcome;
+		try {
+			if (!refused[i].empty())
+				outcome.error = refused[i];
+			else if (*command == "validate")
+				outcome.output = validate_file(files[i]);
+			else if (*command == "decode")
+				outcome.output = decode_file(files[i]);
+			else if (*command == "reencode")
+				outcome.output = reencode_file(files[i], reencode_options);
+			else
+				outcome.output = query_file(files[i], *query);
+		} catch (const std::exception &error) {
+			outcome.error = error.what();
+		}
+
+		finish(i, std::move(outcome));
+	});
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
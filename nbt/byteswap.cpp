@@ -0,0 +1,103 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "byteswap.hpp"
+
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NBT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace nbt {
+
+	using SwapKernel = void (*)(std::byte *dst, const std::byte *src, size_t count);
+
+	template <size_t Width> static void swap_copy_scalar(std::byte *dst, const std::byte *src, size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			for (size_t j = 0; j < Width; ++j)
+				dst[i * Width + j] = src[i * Width + (Width - j - 1)];
+		}
+	}
+
+#ifdef NBT_X86_KERNELS
+	// pshufb masks reversing each 4 or 8 byte lane of a 16 byte block
+	static const uint8_t SWAP_MASK_32[16] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+	static const uint8_t SWAP_MASK_64[16] = {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+
+	template <size_t Width>
+	__attribute__((target("ssse3"))) static void swap_copy_ssse3(std::byte *dst, const std::byte *src, size_t count) {
+		const __m128i mask =
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(Width == 4 ? SWAP_MASK_32 : SWAP_MASK_64));
+		constexpr size_t STEP = 16 / Width;
+
+		size_t i = 0;
+		for (; i + STEP <= count; i += STEP) {
+			const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * Width));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * Width), _mm_shuffle_epi8(value, mask));
+		}
+
+		swap_copy_scalar<Width>(dst + i * Width, src + i * Width, count - i);
+	}
+
+	template <size_t Width>
+	__attribute__((target("avx2"))) static void swap_copy_avx2(std::byte *dst, const std::byte *src, size_t count) {
+		// vpshufb shuffles within each 128-bit half, so the same mask is simply repeated
+		const __m256i mask = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(Width == 4 ? SWAP_MASK_32 : SWAP_MASK_64)));
+		constexpr size_t STEP = 32 / Width;
+
+		size_t i = 0;
+		for (; i + STEP <= count; i += STEP) {
+			const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * Width));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * Width), _mm256_shuffle_epi8(value, mask));
+		}
+
+		swap_copy_scalar<Width>(dst + i * Width, src + i * Width, count - i);
+	}
+#endif
+
+	template <size_t Width> static SwapKernel select_kernel() {
+#ifdef NBT_X86_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return swap_copy_avx2<Width>;
+		if (__builtin_cpu_supports("ssse3"))
+			return swap_copy_ssse3<Width>;
+#endif
+		return swap_copy_scalar<Width>;
+	}
+
+	void swap_copy_32(std::byte *dst, const std::byte *src, size_t count) {
+		static const SwapKernel kernel = select_kernel<4>();
+		kernel(dst, src, count);
+	}
+
+	void swap_copy_64(std::byte *dst, const std::byte *src, size_t count) {
+		static const SwapKernel kernel = select_kernel<8>();
+		kernel(dst, src, count);
+	}
+
+}
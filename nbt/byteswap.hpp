@@ -0,0 +1,67 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace nbt {
+
+	// Copy count 32/64-bit values from src to dst, reversing the byte order of each. The swap is its own inverse, so
+	// these convert big-endian payloads to native order and back. Vectorised kernels are picked at runtime.
+	void swap_copy_32(std::byte *dst, const std::byte *src, size_t count);
+	void swap_copy_64(std::byte *dst, const std::byte *src, size_t count);
+
+	template <typename T> void load_big_endian_array(T *dst, const std::byte *src, size_t count) {
+		static_assert(sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8);
+
+		// an empty array's storage may be null, which memcpy must never be given, even for nothing
+		if (count == 0)
+			return;
+
+		if constexpr (sizeof(T) == 1 || std::endian::native == std::endian::big)
+			memcpy(dst, src, count * sizeof(T));
+		else if constexpr (sizeof(T) == 4)
+			swap_copy_32(reinterpret_cast<std::byte *>(dst), src, count);
+		else
+			swap_copy_64(reinterpret_cast<std::byte *>(dst), src, count);
+	}
+
+	template <typename T> void store_big_endian_array(std::byte *dst, const T *src, size_t count) {
+		static_assert(sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8);
+
+		if (count == 0)
+			return;
+
+		if constexpr (sizeof(T) == 1 || std::endian::native == std::endian::big)
+			memcpy(dst, src, count * sizeof(T));
+		else if constexpr (sizeof(T) == 4)
+			swap_copy_32(dst, reinterpret_cast<const std::byte *>(src), count);
+		else
+			swap_copy_64(dst, reinterpret_cast<const std::byte *>(src), count);
+	}
+
+}
@@ -0,0 +1,140 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inflate.hpp"
+#include "io.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <zlib.h>
+
+namespace nbt {
+
+	Compression detect_compression(std::span<const std::byte> header) {
+		if (header.size() < 2)
+			return Compression::NONE;
+
+		const auto first = std::to_integer<uint8_t>(header[0]);
+		const auto second = std::to_integer<uint8_t>(header[1]);
+
+		if (first == 0x1F && second == 0x8B)
+			return Compression::GZIP;
+		// deflate method, a window of at most 32 KiB and a valid check value
+		if ((first & 0x0F) == 8 && (first >> 4) <= 7 && (first * 256 + second) % 31 == 0 && first >= TAG_ID_COUNT)
+			return Compression::ZLIB;
+
+		return Compression::NONE;
+	}
+
+	InflateSource::InflateSource(Source &input, Compression compression)
+		: input(input), stream(std::make_unique<z_stream_s>()), buffer(BLOCK_SIZE) {
+		// 16 asks zlib for a gzip wrapper rather than a zlib one
+		const int window_bits = compression == Compression::GZIP ? 16 + MAX_WBITS : MAX_WBITS;
+		if (inflateInit2(stream.get(), window_bits) != Z_OK)
+			throw IOError("Could not initialise zlib");
+	}
+
+	InflateSource::~InflateSource() {
+		// whatever follows the compressed stream was read ahead along with it
+		input.put_back(stream->avail_in);
+		inflateEnd(stream.get());
+	}
+
+	size_t InflateSource::read(std::byte *data, size_t length) {
+		if (finished || length == 0)
+			return 0;
+
+		stream->next_out = reinterpret_cast<Bytef *>(data);
+		stream->avail_out = static_cast<uInt>(std::min<size_t>(length, UINT_MAX));
+		const uInt requested = stream->avail_out;
+
+		while (stream->avail_out == requested) {
+			if (stream->avail_in == 0) {
+				const size_t count = input.read(buffer.data(), buffer.size());
+				// a truncated stream simply ends early, which the reader reports as EOF
+				if (count == 0)
+					break;
+
+				stream->next_in = reinterpret_cast<Bytef *>(buffer.data());
+				stream->avail_in = static_cast<uInt>(count);
+			}
+
+			const int status = inflate(stream.get(), Z_NO_FLUSH);
+			if (status == Z_STREAM_END) {
+				finished = true;
+				break;
+			}
+			if (status != Z_OK && status != Z_BUF_ERROR)
+				throw IOError(stream->msg != nullptr ? stream->msg : "Invalid compressed data");
+		}
+
+		return requested - stream->avail_out;
+	}
+
+	std::vector<std::byte> inflate_all(Source &input, Compression compression) {
+		InflateSource source(input, compression);
+		std::vector<std::byte> result(256 * 1024);
+
+		size_t size = 0;
+		while (true) {
+			if (size == result.size())
+				result.resize(size * 2);
+
+			const size_t count = source.read(result.data() + size, result.size() - size);
+			if (count == 0)
+				break;
+
+			size += count;
+		}
+
+		result.resize(size);
+		return result;
+	}
+
+	std::vector<std::byte> deflate_all(std::span<const std::byte> data, Compression compression) {
+		if (compression == Compression::NONE)
+			return {data.begin(), data.end()};
+
+		z_stream stream = {};
+		const int window_bits = compression == Compression::GZIP ? 16 + MAX_WBITS : MAX_WBITS;
+		if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw IOError("Could not initialise zlib");
+
+		// the bound allows for the wrapper asked for, so the output always fits in one call
+		std::vector<std::byte> result(deflateBound(&stream, static_cast<uLong>(data.size())));
+		stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(data.data()));
+		stream.avail_in = static_cast<uInt>(data.size());
+		stream.next_out = reinterpret_cast<Bytef *>(result.data());
+		stream.avail_out = static_cast<uInt>(result.size());
+
+		const int status = deflate(&stream, Z_FINISH);
+		deflateEnd(&stream);
+		if (status != Z_STREAM_END)
+			throw IOError("Could not compress data");
+
+		result.resize(stream.total_out);
+		return result;
+	}
+
+}
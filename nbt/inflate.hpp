@@ -0,0 +1,72 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "source.hpp"
+#include <memory>
+#include <vector>
+
+struct z_stream_s;
+
+namespace nbt {
+
+	enum class Compression {
+		NONE,
+		GZIP,
+		ZLIB
+	};
+
+	// Guess the compression of an input from its first two bytes. This is unambiguous, as neither header can start
+	// with a valid tag ID.
+	Compression detect_compression(std::span<const std::byte> header);
+
+	// Inflates a gzip or zlib stream block by block as the reader asks for more, so that decompression and decoding
+	// overlap and the whole inflated input never has to be held at once.
+	class InflateSource : public Source {
+	public:
+		InflateSource(Source &input, Compression compression);
+		~InflateSource() override;
+
+		InflateSource(const InflateSource &) = delete;
+		InflateSource &operator=(const InflateSource &) = delete;
+
+		size_t read(std::byte *data, size_t length) override;
+
+	private:
+		static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+		Source &input;
+		std::unique_ptr<z_stream_s> stream;
+		std::vector<std::byte> buffer;
+		bool finished = false;
+	};
+
+	// Inflate the whole of a compressed input into memory.
+	std::vector<std::byte> inflate_all(Source &input, Compression compression);
+
+	// Compress data in one go, or copy it if compression is NONE. Inputs past 4 GiB are not supported.
+	std::vector<std::byte> deflate_all(std::span<const std::byte> data, Compression compression);
+
+}
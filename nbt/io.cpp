@@ -23,289 +23,1098 @@
  */
 
 #include "io.hpp"
+#include "byteswap.hpp"
+#include "inflate.hpp"
+#include "mapped_file.hpp"
+#include "mutf8.hpp"
+#include "parallel.hpp"
+#include "reader.hpp"
+#include "visitor.hpp"
+#include "walker.hpp"
+#include "writer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
 #include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace nbt {
 
-	static constexpr int MAX_DEPTH = 1024;
+	// Settings for one decode, passed down to every level.
+	struct Context {
+		bool lazy = false;
+		std::shared_ptr<const void> owner; // keeps the input alive for deferred tags
+		std::pmr::memory_resource *memory = std::pmr::get_default_resource();
+		KeyTable *keys = nullptr;
+		int max_depth = MAX_DEPTH;
+		bool borrow = false; // strings may point into the input
+		int threads = 1; // for read_root_parallel
+	};
 
-	static NamedTag read_named(QIODevice *file, int depth);
-	static Tag read_unnamed(QIODevice *file, int depth);
-	static Tag read_payload(QIODevice *file, TagType type, int depth);
-	static int8_t read_byte(QIODevice *file);
-	static int16_t read_short(QIODevice *file);
-	static int32_t read_int(QIODevice *file);
-	static int64_t read_long(QIODevice *file);
-	static float read_float(QIODevice *file);
-	static double read_double(QIODevice *file);
-	static TagType read_tag_type(QIODevice *file);
-	static QByteArray read_bytes(QIODevice *file, int length);
-	static QString read_string(QIODevice *file);
+	static NamedTag read_named(Reader &reader, const Context &context);
+	static Tag read_unnamed(Reader &reader, const Context &context);
+	static std::vector<std::byte> read_all(Source &input);
 
-	NamedTag read_named_binary(QIODevice *file) {
-		return read_named(file, 0);
+	const char *describe(ErrorCode error) {
+		switch (error) {
+			case ErrorCode::NONE:
+				return "";
+			case ErrorCode::END_OF_INPUT:
+				return "EOF";
+			case ErrorCode::INVALID_TAG_ID:
+				return "Invalid tag ID";
+			case ErrorCode::NEGATIVE_LENGTH:
+				return "Negative length";
+			case ErrorCode::MAX_DEPTH_REACHED:
+				return "Max depth reached";
+			case ErrorCode::INVALID_STRING:
+				return "Invalid string encoding";
+			case ErrorCode::BAD_INPUT:
+				return "Bad input";
+		}
+
+		return "Unknown error";
 	}
 
-	Tag read_unnamed_binary(QIODevice *file) {
-		return read_unnamed(file, 0);
+	// result, if the reader that decoded it got through without an error
+	template <typename Result>
+	static std::optional<Result> finish(const Reader &reader, Result result, ReadStatus &status) {
+		if (reader.failed()) {
+			status = {reader.error(), reader.error_position(), describe(reader.error())};
+			return {};
+		}
+
+		status = {};
+		return result;
 	}
 
-	static NamedTag read_named(QIODevice *file, int depth) {
-		const TagType type = read_tag_type(file);
-		if (type == TagType::END)
+	// Runs read, reporting an IOError thrown by the input itself (a file that will not open, a corrupt compressed
+	// stream) in status like any other failure. The decoder's own errors never get here, as it does not throw them.
+	// Running out of memory is reported the same way: allocations are bounded by the input, so it takes input that
+	// claims to hold more than will fit.
+	template <typename Read> static auto guard(ReadStatus &status, Read read) -> decltype(read()) {
+		try {
+			return read();
+		} catch (const IOError &error) {
+			status = {ErrorCode::BAD_INPUT, 0, error.what()};
+			return {};
+		} catch (const std::bad_alloc &) {
+			status = {ErrorCode::BAD_INPUT, 0, "Out of memory"};
 			return {};
+		}
+	}
+
+	template <typename Result> static Result value_or_throw(std::optional<Result> result, const ReadStatus &status) {
+		if (!result.has_value())
+			throw IOError(status.message);
 
-		const QString name = read_string(file);
-		return {read_payload(file, type, depth), name};
+		return std::move(result.value());
 	}
 
-	static Tag read_unnamed(QIODevice *file, int depth) {
-		const TagType type = read_tag_type(file);
-		return read_payload(file, type, depth);
+	// Decodes the decompressed contents of input. contiguous is the whole input when it is already in memory, and owner
+	// whatever keeps it there. Decompression streams into the decoder, unless a lazy read needs the inflated bytes
+	// kept or a parallel one needs them all at hand. Strings are only ever borrowed from contiguous input, the one kind
+	// that stays put after the read.
+	template <typename Decode, typename Result = std::invoke_result_t<Decode, Reader &, const Context &>>
+	static std::optional<Result> read_binary(Source &input, Compression compression,
+		const std::span<const std::byte> *contiguous, std::shared_ptr<const void> owner, const ReadOptions &options,
+		ReadStatus &status, Decode decode) {
+		std::pmr::memory_resource *memory =
+			options.memory != nullptr ? options.memory : std::pmr::get_default_resource();
+		// the tree outlives a table private to the read, so that one counts references to its keys
+		KeyTable local_keys(false, KeyLifetime::OWN);
+		KeyTable *keys = options.keys != nullptr ? options.keys : &local_keys;
+
+		if (compression == Compression::NONE && contiguous != nullptr) {
+			Reader reader(*contiguous);
+			const Context context = {options.lazy, std::move(owner), memory, keys, options.max_depth,
+				options.borrow_strings, options.threads};
+			Result result = decode(reader, context);
+			return finish(reader, std::move(result), status);
+		}
+
+		if (options.lazy || options.threads != 1) {
+			// a parallel read splits up the input as a whole, and deferred payloads point into it, so it has to be
+			// owned for as long as they live
+			std::shared_ptr<std::vector<std::byte>> bytes;
+			if (compression == Compression::NONE)
+				bytes = std::make_shared<std::vector<std::byte>>(read_all(input));
+			else
+				bytes = std::make_shared<std::vector<std::byte>>(inflate_all(input, compression));
+
+			Reader reader(*bytes);
+			Result result =
+				decode(reader, {options.lazy, bytes, memory, keys, options.max_depth, false, options.threads});
+			return finish(reader, std::move(result), status);
+		}
+
+		if (compression == Compression::NONE) {
+			Reader reader(&input);
+			Result result = decode(reader, {false, nullptr, memory, keys, options.max_depth});
+			return finish(reader, std::move(result), status);
+		}
+
+		InflateSource inflated(input, compression);
+		Reader reader(&inflated);
+		Result result = decode(reader, {false, nullptr, memory, keys, options.max_depth});
+		return finish(reader, std::move(result), status);
 	}
 
-	static Tag read_payload(QIODevice *file, TagType type, int depth) {
-		if (depth > MAX_DEPTH)
-			throw IOError("Max depth reached");
+	ReadOptions with_keys(const ReadOptions &options, KeyTable &fallback) {
+		ReadOptions result = options;
+		if (result.keys == nullptr)
+			result.keys = &fallback;
 
-		switch (type) {
-			case TagType::END:
-				return {};
-			case TagType::BYTE:
-				return Tag::of_byte(read_byte(file));
-			case TagType::SHORT:
-				return Tag::of_short(read_short(file));
-			case TagType::INT:
-				return Tag::of_int(read_int(file));
-			case TagType::LONG:
-				return Tag::of_long(read_long(file));
-			case TagType::FLOAT:
-				return Tag::of_float(read_float(file));
-			case TagType::DOUBLE:
-				return Tag::of_double(read_double(file));
-			case TagType::BYTE_ARRAY: {
-				Tag result = Tag::of_byte_array();
+		return result;
+	}
 
-				int32_t length = read_int(file);
-				result.list_value().reserve(length);
-				while (length-- != 0)
-					result.list_value().append(Tag::of_byte(read_byte(file)));
+	// The first two bytes of input, for telling its compression, put back for the decoder to read again.
+	static Compression detect_stream_compression(std::istream &input) {
+		char header[2];
+		input.read(header, sizeof(header));
+		const auto count = static_cast<size_t>(input.gcount());
 
-				return result;
-			}
-			case TagType::STRING: {
-				return Tag::of_string(read_string(file));
-			}
-			case TagType::LIST: {
-				TagType item_type = read_tag_type(file);
-				int32_t length = read_int(file);
+		input.clear(input.rdstate() & std::ios::badbit);
+		for (size_t i = count; i-- > 0;)
+			input.putback(header[i]);
+		if (input.bad())
+			throw IOError("Read error");
 
-				Tag result = Tag::of_list(item_type);
-				result.list_value().reserve(length);
-				while (length-- != 0)
-					result.list_value().append(read_payload(file, item_type, depth + 1));
+		return detect_compression({reinterpret_cast<const std::byte *>(header), count});
+	}
 
-				return result;
-			}
-			case TagType::COMPOUND: {
-				Tag result = Tag::of_compound();
+	std::optional<NamedTag> try_read_named_binary(std::istream &input, ReadStatus &status, const ReadOptions &options) {
+		return guard(status, [&] {
+			StreamSource source(input);
+			return read_binary(source, detect_stream_compression(input), nullptr, nullptr, options, status, read_named);
+		});
+	}
 
-				NamedTag item;
-				while ((item = read_named(file, depth)).tag.type() != TagType::END)
-					result.compound_value().append(item);
+	std::optional<Tag> try_read_unnamed_binary(std::istream &input, ReadStatus &status, const ReadOptions &options) {
+		return guard(status, [&] {
+			StreamSource source(input);
+			return read_binary(
+				source, detect_stream_compression(input), nullptr, nullptr, options, status, read_unnamed);
+		});
+	}
 
-				return result;
-			}
-			case TagType::INT_ARRAY: {
-				Tag result = Tag::of_int_array();
+	std::optional<NamedTag> try_read_named_binary(
+		std::span<const std::byte> data, ReadStatus &status, const ReadOptions &options) {
+		return try_read_named_binary(data, nullptr, status, options);
+	}
 
-				int32_t length = read_int(file);
-				result.list_value().reserve(length);
-				while (length-- != 0)
-					result.list_value().append(Tag::of_int(read_int(file)));
+	std::optional<Tag> try_read_unnamed_binary(
+		std::span<const std::byte> data, ReadStatus &status, const ReadOptions &options) {
+		return try_read_unnamed_binary(data, nullptr, status, options);
+	}
 
-				return result;
-			}
-			case TagType::LONG_ARRAY: {
-				Tag result = Tag::of_long_array();
+	std::optional<NamedTag> try_read_named_binary(std::span<const std::byte> data, std::shared_ptr<const void> owner,
+		ReadStatus &status, const ReadOptions &options) {
+		return guard(status, [&] {
+			SpanSource input(data);
+			return read_binary(input, detect_compression(data), &data, std::move(owner), options, status, read_named);
+		});
+	}
 
-				int32_t length = read_int(file);
-				result.list_value().reserve(length);
-				while (length-- != 0)
-					result.list_value().append(Tag::of_long(read_long(file)));
+	std::optional<Tag> try_read_unnamed_binary(std::span<const std::byte> data, std::shared_ptr<const void> owner,
+		ReadStatus &status, const ReadOptions &options) {
+		return guard(status, [&] {
+			SpanSource input(data);
+			return read_binary(input, detect_compression(data), &data, std::move(owner), options, status, read_unnamed);
+		});
+	}
 
-				return result;
-			}
-		}
+	// options for a read whose input goes away when it returns, which nothing may be borrowed from
+	static ReadOptions copying(const ReadOptions &options) {
+		ReadOptions result = options;
+		result.borrow_strings = false;
+		return result;
+	}
 
-		throw IOError("Unknown tag ID");
+	std::optional<NamedTag> try_read_named_binary(
+		const std::filesystem::path &path, ReadStatus &status, const ReadOptions &options) {
+		return guard(status, [&] {
+			const auto file = std::make_shared<const MappedFile>(path);
+			const std::span<const std::byte> data = file->data();
+			SpanSource input(data);
+			return read_binary(input, detect_compression(data), &data, file, copying(options), status, read_named);
+		});
 	}
 
-	static int8_t read_byte(QIODevice *file) {
-		char result;
-		if (file->atEnd())
-			throw IOError("EOF");
-		if (!file->getChar(&result))
-			throw IOError(file->errorString());
+	std::optional<Tag> try_read_unnamed_binary(
+		const std::filesystem::path &path, ReadStatus &status, const ReadOptions &options) {
+		return guard(status, [&] {
+			const auto file = std::make_shared<const MappedFile>(path);
+			const std::span<const std::byte> data = file->data();
+			SpanSource input(data);
+			return read_binary(input, detect_compression(data), &data, file, copying(options), status, read_unnamed);
+		});
+	}
 
-		return static_cast<int8_t>(result);
+	NamedTag read_named_binary(std::istream &input, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_named_binary(input, status, options), status);
 	}
 
-	static int16_t read_short(QIODevice *file) {
-		uint8_t bytes[2];
-		if (file->read(reinterpret_cast<char *>(bytes), sizeof(bytes)) != sizeof(bytes))
-			throw IOError("EOF");
+	Tag read_unnamed_binary(std::istream &input, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_unnamed_binary(input, status, options), status);
+	}
 
-		return static_cast<int16_t>((bytes[0] << 8) + (bytes[1] << 0));
+	NamedTag read_named_binary(std::span<const std::byte> data, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_named_binary(data, status, options), status);
 	}
 
-	static int32_t read_int(QIODevice *file) {
-		uint8_t bytes[4];
-		if (file->read(reinterpret_cast<char *>(bytes), sizeof(bytes)) != sizeof(bytes))
-			throw IOError("EOF");
+	Tag read_unnamed_binary(std::span<const std::byte> data, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_unnamed_binary(data, status, options), status);
+	}
 
-		return static_cast<int32_t>((bytes[0] << 24) + (bytes[1] << 16) + (bytes[2] << 8) + (bytes[3] << 0));
+	NamedTag read_named_binary(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_named_binary(data, std::move(owner), status, options), status);
 	}
 
-	static int64_t read_long(QIODevice *file) {
-		uint8_t bytes[8];
-		if (file->read(reinterpret_cast<char *>(bytes), sizeof(bytes)) != sizeof(bytes))
-			throw IOError("EOF");
+	Tag read_unnamed_binary(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_unnamed_binary(data, std::move(owner), status, options), status);
+	}
 
-		return static_cast<int32_t>((((int64_t)bytes[0] << 56) + ((int64_t)(bytes[1] & 255) << 48) +
-									 ((int64_t)(bytes[2] & 255) << 40) + ((int64_t)(bytes[3] & 255) << 32) +
-									 ((int64_t)(bytes[4] & 255) << 24) + ((bytes[5] & 255) << 16) +
-									 ((bytes[6] & 255) << 8) + ((bytes[7] & 255) << 0)));
+	NamedTag read_named_binary(const std::filesystem::path &path, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_named_binary(path, status, options), status);
 	}
 
-	static float read_float(QIODevice *file) {
-		const int32_t src = read_int(file);
-		float dst;
-		static_assert(sizeof(src) == sizeof(dst));
-		memcpy(&dst, &src, sizeof(src));
-		return dst;
+	Tag read_unnamed_binary(const std::filesystem::path &path, const ReadOptions &options) {
+		ReadStatus status;
+		return value_or_throw(try_read_unnamed_binary(path, status, options), status);
 	}
 
-	static double read_double(QIODevice *file) {
-		const int64_t src = read_long(file);
-		double dst;
-		static_assert(sizeof(src) == sizeof(dst));
-		memcpy(&dst, &src, sizeof(src));
-		return dst;
+	// Unless the options ask for a lazy read, whose deferred payloads are on the heap, or name a key table of their own,
+	// whose keys may be counted, everything a read puts in the tree then comes from the document or its input.
+	template <typename Decode> void Document::read_root(ReadOptions options, Decode decode) {
+		options.memory = memory();
+		if (options.keys == nullptr)
+			options.keys = keys();
+
+		state->root = decode(options);
+		state->arena_only = !options.lazy && options.keys == keys();
 	}
 
-	static TagType read_tag_type(QIODevice *file) {
-		int8_t id = read_byte(file);
-		if (id < 0 || id >= TAG_ID_COUNT)
-			throw IOError(QString("Invalid tag ID: %1").arg(id));
+	Document Document::read_borrowing(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, ReadOptions options) {
+		if (const Compression compression = detect_compression(data); compression != Compression::NONE) {
+			SpanSource input(data);
+			auto inflated = std::make_shared<const std::vector<std::byte>>(inflate_all(input, compression));
+			data = *inflated;
+			owner = std::move(inflated);
+		}
 
-		return static_cast<TagType>(id);
+		Document result(owner);
+		result.read_root(options, [&](const ReadOptions &with) { return read_named_binary(data, owner, with); });
+		return result;
 	}
 
-	static QByteArray read_bytes(QIODevice *file, int32_t length) {
-		QByteArray result = file->read(length);
-		if (result.length() != length)
-			throw IOError("EOF");
+	Document read_named_document(std::istream &input, ReadOptions options) {
+		if (options.borrow_strings) {
+			StreamSource source(input);
+			const auto bytes = std::make_shared<const std::vector<std::byte>>(read_all(source));
+			return Document::read_borrowing(*bytes, bytes, options);
+		}
 
+		Document result;
+		result.read_root(options, [&](const ReadOptions &with) { return read_named_binary(input, with); });
 		return result;
 	}
 
-	static QString read_string(QIODevice *file) {
-		const uint16_t length = read_short(file);
-		return QString::fromUtf8(read_bytes(file, length));
+	Document read_named_document(std::span<const std::byte> data, ReadOptions options) {
+		if (options.borrow_strings)
+			return Document::read_borrowing(data, nullptr, options);
+
+		Document result;
+		result.read_root(options, [&](const ReadOptions &with) { return read_named_binary(data, with); });
+		return result;
 	}
 
-	static void write_named(QIODevice *file, const NamedTag &value, int depth);
-	static void write_unnamed(QIODevice *file, const Tag &value, int depth);
-	static void write_payload(QIODevice *file, const Tag &value, int depth);
-	static void write_byte(QIODevice *file, int8_t value);
-	static void write_short(QIODevice *file, int16_t value);
-	static void write_int(QIODevice *file, int32_t value);
-	static void write_long(QIODevice *file, int64_t value);
-	static void write_float(QIODevice *file, float value);
-	static void write_double(QIODevice *file, double value);
-	static void write_string(QIODevice *file, const QString &value);
-	static void write_bytes(QIODevice *file, const QByteArray &value);
+	Document read_named_document(const std::filesystem::path &path, ReadOptions options) {
+		if (options.borrow_strings) {
+			const auto file = std::make_shared<const MappedFile>(path);
+			return Document::read_borrowing(file->data(), file, options);
+		}
 
-	void write_named_binary(QIODevice *file, const NamedTag &tag) {
-		write_named(file, tag, 0);
+		Document result;
+		result.read_root(options, [&](const ReadOptions &with) { return read_named_binary(path, with); });
+		return result;
 	}
 
-	void write_unnamed_binary(QIODevice *file, const Tag &tag) {
-		write_unnamed(file, tag, 0);
+	// Hands the walk on to a user's visitor, noting anything it throws. guard turns an IOError or bad_alloc into a
+	// status, which is right for the input but not for the visitor, whose exceptions go straight through.
+	class Relay final : public Visitor {
+	public:
+		explicit Relay(Visitor &visitor) : visitor(visitor) {}
+
+		Visit key(std::string_view name) override {
+			return relay([&] { return visitor.key(name); });
+		}
+
+		Visit begin_compound() override {
+			return relay([&] { return visitor.begin_compound(); });
+		}
+
+		Visit begin_list(TagType item_type, int32_t length) override {
+			return relay([&] { return visitor.begin_list(item_type, length); });
+		}
+
+		Visit begin_array(TagType type, int32_t length) override {
+			return relay([&] { return visitor.begin_array(type, length); });
+		}
+
+		void array_chunk(std::span<const Byte> values) override {
+			relay([&] { visitor.array_chunk(values); });
+		}
+
+		void array_chunk(std::span<const Int> values) override {
+			relay([&] { visitor.array_chunk(values); });
+		}
+
+		void array_chunk(std::span<const Long> values) override {
+			relay([&] { visitor.array_chunk(values); });
+		}
+
+		void end() override {
+			relay([&] { visitor.end(); });
+		}
+
+		void byte_value(Byte value) override {
+			relay([&] { visitor.byte_value(value); });
+		}
+
+		void short_value(Short value) override {
+			relay([&] { visitor.short_value(value); });
+		}
+
+		void int_value(Int value) override {
+			relay([&] { visitor.int_value(value); });
+		}
+
+		void long_value(Long value) override {
+			relay([&] { visitor.long_value(value); });
+		}
+
+		void float_value(Float value) override {
+			relay([&] { visitor.float_value(value); });
+		}
+
+		void double_value(Double value) override {
+			relay([&] { visitor.double_value(value); });
+		}
+
+		void string_value(std::string_view value) override {
+			relay([&] { visitor.string_value(value); });
+		}
+
+		void skipped(TagType type, TagType content_type, std::span<const std::byte> payload, int32_t length) override {
+			relay([&] { visitor.skipped(type, content_type, payload, length); });
+		}
+
+		// throws again whatever the visitor threw, if anything
+		void rethrow() const {
+			if (thrown != nullptr)
+				std::rethrow_exception(thrown);
+		}
+
+	private:
+		Visitor &visitor;
+		std::exception_ptr thrown;
+
+		template <typename Call> auto relay(Call call) -> decltype(call()) {
+			try {
+				return call();
+			} catch (...) {
+				thrown = std::current_exception();
+				throw;
+			}
+		}
+	};
+
+	// Walks visitor through the decompressed contents of input. Nothing is deferred, so the read is never lazy.
+	static std::optional<bool> walk_binary(Source &input, Compression compression,
+		const std::span<const std::byte> *contiguous, const ReadOptions &options, ReadStatus &status, Relay &visitor,
+		bool named) {
+		ReadOptions plain;
+		plain.max_depth = options.max_depth;
+		const auto walk = [&](Reader &reader, const Context &context) {
+			Walker<Relay> walker(reader, visitor, context.max_depth);
+			if (named)
+				walker.named(0);
+			else
+				walker.unnamed(0);
+			return true;
+		};
+
+		return read_binary(input, compression, contiguous, nullptr, plain, status, walk);
 	}
 
-	template <typename To, typename From> static std::optional<To> numeric_cast(From value) {
-		if (!std::numeric_limits<To>::is_signed && value < 0)
+	// Runs walk under guard with visitor relayed, so that only the input's own failures end up in the status.
+	template <typename Walk> static ReadStatus visit_binary(Visitor &visitor, Walk walk) {
+		ReadStatus status;
+		Relay relay(visitor);
+		guard(status, [&] { return walk(relay, status); });
+		relay.rethrow();
+		return status;
+	}
+
+	ReadStatus visit_named_binary(std::istream &input, Visitor &visitor, const ReadOptions &options) {
+		return visit_binary(visitor, [&](Relay &relay, ReadStatus &status) {
+			StreamSource source(input);
+			return walk_binary(source, detect_stream_compression(input), nullptr, options, status, relay, true);
+		});
+	}
+
+	ReadStatus visit_unnamed_binary(std::istream &input, Visitor &visitor, const ReadOptions &options) {
+		return visit_binary(visitor, [&](Relay &relay, ReadStatus &status) {
+			StreamSource source(input);
+			return walk_binary(source, detect_stream_compression(input), nullptr, options, status, relay, false);
+		});
+	}
+
+	ReadStatus visit_named_binary(std::span<const std::byte> data, Visitor &visitor, const ReadOptions &options) {
+		return visit_binary(visitor, [&](Relay &relay, ReadStatus &status) {
+			SpanSource input(data);
+			return walk_binary(input, detect_compression(data), &data, options, status, relay, true);
+		});
+	}
+
+	ReadStatus visit_unnamed_binary(std::span<const std::byte> data, Visitor &visitor, const ReadOptions &options) {
+		return visit_binary(visitor, [&](Relay &relay, ReadStatus &status) {
+			SpanSource input(data);
+			return walk_binary(input, detect_compression(data), &data, options, status, relay, false);
+		});
+	}
+
+	ReadStatus visit_named_binary(const std::filesystem::path &path, Visitor &visitor, const ReadOptions &options) {
+		return visit_binary(visitor, [&](Relay &relay, ReadStatus &status) {
+			const MappedFile file(path);
+			const std::span<const std::byte> data = file.data();
+			SpanSource input(data);
+			return walk_binary(input, detect_compression(data), &data, options, status, relay, true);
+		});
+	}
+
+	ReadStatus visit_unnamed_binary(const std::filesystem::path &path, Visitor &visitor, const ReadOptions &options) {
+		return visit_binary(visitor, [&](Relay &relay, ReadStatus &status) {
+			const MappedFile file(path);
+			const std::span<const std::byte> data = file.data();
+			SpanSource input(data);
+			return walk_binary(input, detect_compression(data), &data, options, status, relay, false);
+		});
+	}
+
+	static std::vector<std::byte> read_all(Source &input) {
+		std::vector<std::byte> result(256 * 1024);
+
+		size_t size = 0;
+		while (true) {
+			if (size == result.size())
+				result.resize(size * 2);
+
+			const size_t count = input.read(result.data() + size, result.size() - size);
+			if (count == 0)
+				break;
+
+			size += count;
+		}
+
+		result.resize(size);
+		return result;
+	}
+
+	// most items a list read from a source has room made for up front
+	constexpr size_t STREAM_RESERVE = 1024;
+
+	// Turns the walk into a tree, which is all reading a tag is: the walker drives it the same way as any visitor.
+	class TreeBuilder final : public Visitor {
+	public:
+		// reader is the one the walk reads from; depth is where the walk starts; defer_root is whether a lazy read
+		// defers the container it starts at too
+		TreeBuilder(const Reader &reader, const Context &context, int depth, bool defer_root)
+			: reader(reader), context(context), depth(depth), defer_root(defer_root) {}
+
+		Visit key(std::string_view name) override {
+			pending = context.keys->intern(name);
+			return Visit::ENTER;
+		}
+
+		Visit begin_compound() override {
+			if (defer())
+				return Visit::SKIP;
+
+			open(Tag::of_compound(Compound(context.memory)));
+			return Visit::ENTER;
+		}
+
+		Visit begin_list(TagType item_type, int32_t length) override {
+			if (defer())
+				return Visit::SKIP;
+
+			Tag list = Tag::of_list(item_type, List(context.memory));
+			list.list_value().reserve(reservable(length));
+			open(std::move(list));
+			return Visit::ENTER;
+		}
+
+		Visit begin_array(TagType type, int32_t length) override {
+			if (type == TagType::BYTE_ARRAY) {
+				array = Tag::of_byte_array(ByteArray(context.memory));
+				array.byte_array_value().reserve(length);
+			} else if (type == TagType::INT_ARRAY) {
+				array = Tag::of_int_array(IntArray(context.memory));
+				array.int_array_value().reserve(length);
+			} else {
+				array = Tag::of_long_array(LongArray(context.memory));
+				array.long_array_value().reserve(length);
+			}
+
+			return Visit::ENTER;
+		}
+
+		// Room for the length values of the array just begun, which the walker fills in place of calling array_chunk.
+		template <typename T> T *array_storage(size_t length) {
+			if constexpr (std::is_same_v<T, Byte>) {
+				array.byte_array_value().resize(length);
+				return array.byte_array_value().data();
+			} else if constexpr (std::is_same_v<T, Int>) {
+				array.int_array_value().resize(length);
+				return array.int_array_value().data();
+			} else {
+				array.long_array_value().resize(length);
+				return array.long_array_value().data();
+			}
+		}
+
+		void array_chunk(std::span<const Byte> values) override {
+			ByteArray &target = array.byte_array_value();
+			target.insert(target.end(), values.begin(), values.end());
+		}
+
+		void array_chunk(std::span<const Int> values) override {
+			IntArray &target = array.int_array_value();
+			target.insert(target.end(), values.begin(), values.end());
+		}
+
+		void array_chunk(std::span<const Long> values) override {
+			LongArray &target = array.long_array_value();
+			target.insert(target.end(), values.begin(), values.end());
+		}
+
+		void end() override {
+			if (array.type() != TagType::END) {
+				add(std::move(array));
+				array = {};
+				return;
+			}
+
+			Frame done = std::move(stack.back());
+			stack.pop_back();
+			pending = std::move(done.name);
+			add(std::move(done.tag));
+		}
+
+		void byte_value(Byte value) override {
+			add(Tag::of_byte(value));
+		}
+
+		void short_value(Short value) override {
+			add(Tag::of_short(value));
+		}
+
+		void int_value(Int value) override {
+			add(Tag::of_int(value));
+		}
+
+		void long_value(Long value) override {
+			add(Tag::of_long(value));
+		}
+
+		void float_value(Float value) override {
+			add(Tag::of_float(value));
+		}
+
+		void double_value(Double value) override {
+			add(Tag::of_double(value));
+		}
+
+		void string_value(std::string_view value) override {
+			if (context.borrow && same_in_utf8(value))
+				add(Tag::of_borrowed_string(value, context.memory));
+			else
+				add(Tag::of_string(from_mutf8(value, context.memory)));
+		}
+
+		void skipped(TagType type, TagType content_type, std::span<const std::byte> payload, int32_t length) override {
+			const int at = depth + static_cast<int>(stack.size());
+			add(Tag::of_deferred(type, content_type, {context.owner, payload, length, at}));
+		}
+
+		NamedTag result() {
+			return {std::move(root), std::move(root_name)};
+		}
+
+	private:
+		// A list or compound part way through being built.
+		struct Frame {
+			Tag tag;
+			Key name; // what the enclosing compound calls it, if that is what encloses it
+		};
+
+		const Reader &reader;
+		const Context &context;
+		const int depth;
+		const bool defer_root;
+		std::vector<Frame> stack;
+		Key pending; // name of the entry whose value comes next
+		Tag array; // the array being filled, if any
+		Tag root;
+		Key root_name;
+
+		// Room for length items, but no more than the rest of the input could hold at a byte each, so that a bogus
+		// length runs out of input rather than memory. How much a source holds is unknown, so its lists start small.
+		size_t reservable(int32_t length) const {
+			const size_t most = reader.contiguous() ? reader.input().size() - reader.offset() : STREAM_RESERVE;
+			return std::min(static_cast<size_t>(length), most);
+		}
+
+		bool defer() const {
+			return context.lazy && (defer_root || !stack.empty());
+		}
+
+		void open(Tag tag) {
+			stack.push_back({std::move(tag), std::move(pending)});
+		}
+
+		void add(Tag tag) {
+			if (stack.empty()) {
+				root = std::move(tag);
+				root_name = std::move(pending);
+				return;
+			}
+
+			Tag &parent = stack.back().tag;
+			if (parent.type() == TagType::LIST)
+				parent.list_value().push_back(std::move(tag));
+			else
+				parent.compound_value().push_back({std::move(tag), std::move(pending)});
+		}
+	};
+
+	// How much input a parallel read hands a thread at a time. Input of less than a couple of pieces is read on one
+	// thread, and lists of less are left whole.
+	constexpr size_t PARALLEL_PIECE_SIZE = 64 * 1024;
+
+	// A stretch of input holding count payloads of one type back to back, which decode without the rest.
+	struct Piece {
+		TagType type;
+		int depth;
+		size_t count;
+		std::span<const std::byte> payload;
+	};
+
+	// An entry of a root read in parallel. Its value is one piece, or for a long list of lists or compounds, the items
+	// of several.
+	struct RootEntry {
+		Key name;
+		bool split;
+		TagType item_type; // if split
+		size_t first; // index of its first piece
+		size_t count; // how many pieces
+	};
+
+	// Whether the root the reader stands at is worth reading with read_root_parallel, which only splits up a compound
+	// already in memory.
+	static bool read_in_parallel(const Reader &reader, const Context &context) {
+		const int threads = context.threads > 0 ? context.threads : default_thread_count();
+		if (threads == 1 || context.lazy || context.memory != std::pmr::get_default_resource() ||
+			!reader.contiguous())
+			return false;
+
+		const std::span<const std::byte> rest = reader.input().subspan(reader.offset());
+		return rest.size() >= 2 * PARALLEL_PIECE_SIZE && rest[0] == static_cast<std::byte>(TagType::COMPOUND);
+	}
+
+	// Finds the pieces of the value of a list entry, which list stands at, splitting it up item by item if it is long
+	// enough to be worth it. Nothing it returns is used if list fails.
+	static RootEntry index_list(Reader &list, Key name, const Context &context, std::vector<Piece> &pieces) {
+		const std::span<const std::byte> input = list.input();
+		const size_t start = list.offset();
+		const size_t first = pieces.size();
+
+		if (context.max_depth < 1) {
+			list.fail(ErrorCode::MAX_DEPTH_REACHED);
 			return {};
+		}
 
-		if (value > std::numeric_limits<To>().max())
+		const TagType item_type = read_tag_type(list);
+		const int32_t length = read_list_length(list, item_type);
+		if (list.failed())
 			return {};
-		if (value < std::numeric_limits<To>().min())
+
+		if (!is_container(item_type)) {
+			skip_items(list, item_type, length, 1, context.max_depth);
+			pieces.push_back({TagType::LIST, 1, 1, input.subspan(start, list.offset() - start)});
+			return {std::move(name), false, TagType::END, first, 1};
+		}
+
+		// items are gathered into runs of about a piece each
+		size_t run_start = list.offset();
+		size_t run_length = 0;
+		for (int32_t i = 0; i < length && !list.failed(); ++i) {
+			skip_payload(list, item_type, 2, context.max_depth);
+			++run_length;
+
+			if (list.offset() - run_start >= PARALLEL_PIECE_SIZE || i == length - 1) {
+				pieces.push_back({item_type, 2, run_length, input.subspan(run_start, list.offset() - run_start)});
+				run_start = list.offset();
+				run_length = 0;
+			}
+		}
+
+		if (pieces.size() - first > 1)
+			return {std::move(name), true, item_type, first, pieces.size() - first};
+
+		pieces.resize(first);
+		pieces.push_back({TagType::LIST, 1, 1, input.subspan(start, list.offset() - start)});
+		return {std::move(name), false, TagType::END, first, 1};
+	}
+
+	// Reads the compound payload the reader stands at by first finding where each of its entries starts and ends,
+	// which takes far less work than decoding them, then decoding them on several threads. Nothing comes back if the
+	// input is broken; the caller reads it again the usual way, so that it is reported just as it would have been.
+	static std::optional<Tag> read_root_parallel(Reader &reader, const Context &context) {
+		const std::span<const std::byte> input = reader.input();
+		std::vector<Piece> pieces;
+		std::vector<RootEntry> entries;
+
+		if (context.max_depth < 0)
+			return {};
+
+		// a failed reader only reads zeros, which end the compound
+		TagType type;
+		while ((type = read_tag_type(reader)) != TagType::END) {
+			Key name = context.keys->intern(read_text(reader));
+			if (type == TagType::LIST) {
+				entries.push_back(index_list(reader, std::move(name), context, pieces));
+				continue;
+			}
+
+			const size_t start = reader.offset();
+			skip_payload(reader, type, 1, context.max_depth);
+			pieces.push_back({type, 1, 1, input.subspan(start, reader.offset() - start)});
+			entries.push_back({std::move(name), false, TagType::END, pieces.size() - 1, 1});
+		}
+
+		if (reader.failed())
+			return {};
+
+		std::vector<std::vector<Tag>> decoded(pieces.size());
+		std::atomic<bool> failed = false;
+		parallel_for(pieces.size(), context.threads, [&](size_t i) {
+			const Piece &piece = pieces[i];
+			Reader part(piece.payload);
+			decoded[i].reserve(piece.count);
+
+			// a table that cannot be shared is only used for the root's own names, and each piece gets one of its own
+			KeyTable piece_keys(false, KeyLifetime::OWN);
+			Context piece_context = context;
+			if (!context.keys->shareable())
+				piece_context.keys = &piece_keys;
+
+			// the builder hands over each item as it is done, and keeps its stack for the next
+			TreeBuilder builder(part, piece_context, piece.depth, false);
+			for (size_t j = 0; j < piece.count && !part.failed(); ++j) {
+				Walker<TreeBuilder>(part, builder, context.max_depth).payload(piece.type, piece.depth);
+				decoded[i].push_back(builder.result().tag);
+			}
+
+			if (part.failed())
+				failed = true;
+		});
+
+		// the first pass already went over every byte by the same rules, so this is only for safety's sake
+		if (failed)
+			return {};
+
+		Compound root(context.memory);
+		root.reserve(entries.size());
+		for (RootEntry &entry : entries) {
+			if (!entry.split) {
+				root.push_back({std::move(decoded[entry.first].front()), std::move(entry.name)});
+				continue;
+			}
+
+			size_t length = 0;
+			for (size_t i = entry.first; i < entry.first + entry.count; ++i)
+				length += decoded[i].size();
+
+			List items(context.memory);
+			items.reserve(length);
+			for (size_t i = entry.first; i < entry.first + entry.count; ++i) {
+				std::move(decoded[i].begin(), decoded[i].end(), std::back_inserter(items));
+				decoded[i].clear();
+			}
+
+			root.push_back({Tag::of_list(entry.item_type, std::move(items)), std::move(entry.name)});
+		}
+
+		return Tag::of_compound(std::move(root));
+	}
+
+	static NamedTag read_named(Reader &reader, const Context &context) {
+		if (read_in_parallel(reader, context)) {
+			// a reader of its own, leaving this one where it was to start over from if the input turns out broken
+			Reader probe(reader.input());
+			probe.skip(reader.offset());
+			read_tag_type(probe);
+			Key name = context.keys->intern(read_text(probe));
+
+			if (std::optional<Tag> tag = read_root_parallel(probe, context); tag.has_value()) {
+				reader.skip(probe.offset() - reader.offset());
+				return {std::move(tag.value()), std::move(name)};
+			}
+		}
+
+		TreeBuilder builder(reader, context, 0, true);
+		Walker<TreeBuilder>(reader, builder, context.max_depth).named(0);
+		return builder.result();
+	}
+
+	static Tag read_unnamed(Reader &reader, const Context &context) {
+		if (read_in_parallel(reader, context)) {
+			Reader probe(reader.input());
+			probe.skip(reader.offset());
+			read_tag_type(probe);
+
+			if (std::optional<Tag> tag = read_root_parallel(probe, context); tag.has_value()) {
+				reader.skip(probe.offset() - reader.offset());
+				return std::move(tag.value());
+			}
+		}
+
+		TreeBuilder builder(reader, context, 0, true);
+		Walker<TreeBuilder>(reader, builder, context.max_depth).unnamed(0);
+		return builder.result().tag;
+	}
+
+	void materialize(Tag &tag) {
+		if (!tag.is_deferred())
+			return;
+
+		const Deferred &deferred = tag.deferred_value();
+
+		// the default resource rather than an arena, which a deferred tag copied out of its document could outlive; no
+		// depth limit either, as the payload was held to the read's when it was skipped over
+		KeyTable keys(false, KeyLifetime::OWN);
+		const Context context = {
+			true, deferred.owner, std::pmr::get_default_resource(), &keys, std::numeric_limits<int>::max()};
+		Reader reader(deferred.payload);
+		TreeBuilder builder(reader, context, deferred.depth, false);
+		Walker<TreeBuilder>(reader, builder, context.max_depth).payload(tag.type(), deferred.depth);
+		if (reader.failed())
+			throw IOError(describe(reader.error()));
+
+		tag = builder.result().tag;
+	}
+
+	static size_t named_size(const NamedTag &value);
+	static size_t payload_size(const Tag &value);
+	static size_t string_size(std::string_view value);
+	static void write_named(Writer &writer, const NamedTag &value, int depth);
+	static void write_unnamed(Writer &writer, const Tag &value, int depth);
+	static void write_payload(Writer &writer, const Tag &value, int depth);
+	static void write_string(Writer &writer, std::string_view value);
+	template <typename T> static void write_array(Writer &writer, const std::pmr::vector<T> &value);
+	static void write_output(std::ostream &output, std::span<const std::byte> encoded);
+
+	// the writer stores every byte of the buffer, so it is left uninitialised rather than zeroed first
+	void write_named_binary(std::ostream &output, const NamedTag &tag) {
+		const size_t size = named_binary_size(tag);
+		const auto encoded = std::make_unique_for_overwrite<std::byte[]>(size);
+		Writer writer({encoded.get(), size});
+		write_named(writer, tag, 0);
+		write_output(output, {encoded.get(), size});
+	}
+
+	void write_unnamed_binary(std::ostream &output, const Tag &tag) {
+		const size_t size = unnamed_binary_size(tag);
+		const auto encoded = std::make_unique_for_overwrite<std::byte[]>(size);
+		Writer writer({encoded.get(), size});
+		write_unnamed(writer, tag, 0);
+		write_output(output, {encoded.get(), size});
+	}
+
+	size_t named_binary_size(const NamedTag &tag) {
+		return named_size(tag);
+	}
+
+	size_t unnamed_binary_size(const Tag &tag) {
+		return 1 + payload_size(tag);
+	}
+
+	template <typename To, typename From> static std::optional<To> numeric_cast(From value) {
+		if (!std::in_range<To>(value))
 			return {};
 
 		return static_cast<To>(value);
 	}
 
-	void write_named(QIODevice *file, const NamedTag &value, int depth) {
+	// Sizing also checks every length fits its prefix, so that encoding afterwards cannot fail halfway.
+	static size_t named_size(const NamedTag &value) {
+		const auto &[tag, name] = value;
+		if (tag.type() == TagType::END)
+			return 1;
+
+		return 1 + string_size(name) + payload_size(tag);
+	}
+
+	static size_t payload_size(const Tag &value) {
+		if (value.is_deferred())
+			return value.deferred_value().payload.size();
+
+		const auto array_size = [](size_t length, size_t width) {
+			if (!numeric_cast<int32_t>(length).has_value())
+				throw IOError("Array too long");
+
+			return 4 + length * width;
+		};
+
+		switch (value.type()) {
+			case TagType::END:
+				return 0;
+			case TagType::BYTE:
+				return 1;
+			case TagType::SHORT:
+				return 2;
+			case TagType::INT:
+			case TagType::FLOAT:
+				return 4;
+			case TagType::LONG:
+			case TagType::DOUBLE:
+				return 8;
+			case TagType::STRING:
+				return string_size(value.string_text());
+			case TagType::BYTE_ARRAY:
+				return array_size(value.byte_array_value().size(), 1);
+			case TagType::INT_ARRAY:
+				return array_size(value.int_array_value().size(), 4);
+			case TagType::LONG_ARRAY:
+				return array_size(value.long_array_value().size(), 8);
+			case TagType::LIST: {
+				if (!numeric_cast<int32_t>(value.list_value().size()).has_value())
+					throw IOError("List too long");
+
+				size_t result = 1 + 4;
+				for (const Tag &tag : value.list_value())
+					result += payload_size(tag);
+				return result;
+			}
+			case TagType::COMPOUND: {
+				size_t result = 1;
+				for (const NamedTag &tag : value.compound_value())
+					result += named_size(tag);
+				return result;
+			}
+		}
+
+		throw IOError("Unknown tag ID");
+	}
+
+	static size_t string_size(std::string_view value) {
+		const size_t size = mutf8_size(value);
+		if (!numeric_cast<uint16_t>(size).has_value())
+			throw IOError("String too long");
+
+		return 2 + size;
+	}
+
+	static void write_named(Writer &writer, const NamedTag &value, int depth) {
 		const auto &[tag, name] = value;
-		write_byte(file, static_cast<int8_t>(tag.type()));
+		writer.write_byte(static_cast<int8_t>(tag.type()));
 		if (tag.type() == TagType::END)
 			return;
 
-		write_string(file, name);
-		write_payload(file, tag, depth);
+		write_string(writer, name);
+		write_payload(writer, tag, depth);
 	}
 
-	void write_unnamed(QIODevice *file, const Tag &value, int depth) {
-		write_byte(file, static_cast<int8_t>(value.type()));
-		write_payload(file, value, depth);
+	static void write_unnamed(Writer &writer, const Tag &value, int depth) {
+		writer.write_byte(static_cast<int8_t>(value.type()));
+		write_payload(writer, value, depth);
 	}
 
-	void write_payload(QIODevice *file, const Tag &value, int depth) {
+	static void write_payload(Writer &writer, const Tag &value, int depth) {
+		// an untouched lazily read payload is still exactly what was read, so it goes back out verbatim
+		if (value.is_deferred()) {
+			writer.write_bytes(value.deferred_value().payload);
+			return;
+		}
+
 		switch (value.type()) {
 			case TagType::END:
 				return;
 			case TagType::BYTE:
-				write_byte(file, value.byte_value());
+				writer.write_byte(value.byte_value());
 				return;
 			case TagType::SHORT:
-				write_short(file, value.short_value());
+				writer.write_short(value.short_value());
 				return;
 			case TagType::INT:
-				write_int(file, value.int_value());
+				writer.write_int(value.int_value());
 				return;
 			case TagType::LONG:
-				write_long(file, value.long_value());
+				writer.write_long(value.long_value());
 				return;
 			case TagType::FLOAT:
-				write_float(file, value.float_value());
+				writer.write_float(value.float_value());
 				return;
 			case TagType::DOUBLE:
-				write_double(file, value.double_value());
+				writer.write_double(value.double_value());
 				return;
 			case TagType::STRING:
-				write_string(file, value.string_value());
+				write_string(writer, value.string_text());
 				return;
-			case TagType::LIST:
 			case TagType::BYTE_ARRAY:
+				write_array(writer, value.byte_array_value());
+				return;
 			case TagType::INT_ARRAY:
-			case TagType::LONG_ARRAY: {
-				if (value.type() == TagType::LIST)
-					write_byte(file, static_cast<int8_t>(value.content_type()));
-
-				write_int(file, value.list_value().length());
+				write_array(writer, value.int_array_value());
+				return;
+			case TagType::LONG_ARRAY:
+				write_array(writer, value.long_array_value());
+				return;
+			case TagType::LIST: {
+				writer.write_byte(static_cast<int8_t>(value.content_type()));
+				writer.write_int(static_cast<int32_t>(value.list_value().size()));
 
 				for (const Tag &tag : value.list_value())
-					write_payload(file, tag, depth + 1);
+					write_payload(writer, tag, depth + 1);
 				return;
 			}
 			case TagType::COMPOUND: {
 				for (const NamedTag &tag : value.compound_value())
-					write_named(file, tag, depth + 1);
+					write_named(writer, tag, depth + 1);
 
-				write_byte(file, static_cast<int8_t>(TagType::END));
+				writer.write_byte(static_cast<int8_t>(TagType::END));
 				return;
 			}
 		}
@@ -313,67 +1122,27 @@ namespace nbt {
 		throw IOError("Unknown tag ID");
 	}
 
-	void write_byte(QIODevice *file, int8_t value) {
-		if (!file->putChar(value))
-			throw IOError(file->errorString());
-	}
-
-	void write_short(QIODevice *file, int16_t value) {
-		QByteArray result(2, Qt::Uninitialized);
-		result[0] = static_cast<char>(value >> 8);
-		result[1] = static_cast<char>(value);
-		file->write(result);
-	}
-
-	void write_int(QIODevice *file, int32_t value) {
-		QByteArray result(4, Qt::Uninitialized);
-		result[0] = static_cast<char>(value >> 24);
-		result[1] = static_cast<char>(value >> 16);
-		result[2] = static_cast<char>(value >> 8);
-		result[3] = static_cast<char>(value);
-		file->write(result);
-	}
-
-	void write_long(QIODevice *file, int64_t value) {
-		QByteArray result(8, Qt::Uninitialized);
-		result[0] = static_cast<char>(value >> 56);
-		result[1] = static_cast<char>(value >> 48);
-		result[2] = static_cast<char>(value >> 40);
-		result[3] = static_cast<char>(value >> 32);
-		result[4] = static_cast<char>(value >> 24);
-		result[5] = static_cast<char>(value >> 16);
-		result[6] = static_cast<char>(value >> 8);
-		result[7] = static_cast<char>(value);
-		file->write(result);
-	}
-
-	void write_float(QIODevice *file, float value) {
-		int32_t result;
-		static_assert(sizeof(value) == sizeof(result));
-		memcpy(&result, &value, sizeof(value));
-		write_int(file, result);
-	}
+	static void write_string(Writer &writer, std::string_view value) {
+		if (is_plain_ascii(value)) {
+			writer.write_short(static_cast<int16_t>(value.size()));
+			writer.write_bytes(std::as_bytes(std::span(value)));
+			return;
+		}
 
-	void write_double(QIODevice *file, double value) {
-		int64_t result;
-		static_assert(sizeof(value) == sizeof(result));
-		memcpy(&result, &value, sizeof(value));
-		write_long(file, result);
+		const std::string encoded = to_mutf8(value);
+		writer.write_short(static_cast<int16_t>(encoded.size()));
+		writer.write_bytes(std::as_bytes(std::span(encoded)));
 	}
 
-	void write_string(QIODevice *file, const QString &value) {
-		QByteArray bytes = value.toUtf8();
-		const auto length = numeric_cast<int16_t>(bytes.length());
-		if (!length.has_value())
-			throw IOError("String too long");
-
-		write_short(file, length.value());
-		write_bytes(file, bytes);
+	template <typename T> static void write_array(Writer &writer, const std::pmr::vector<T> &value) {
+		writer.write_int(static_cast<int32_t>(value.size()));
+		writer.write_array(value.data(), value.size());
 	}
 
-	void write_bytes(QIODevice *file, const QByteArray &value) {
-		if (file->write(value) != value.length())
-			throw IOError(file->errorString());
+	static void write_output(std::ostream &output, std::span<const std::byte> encoded) {
+		output.write(reinterpret_cast<const char *>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+		if (!output)
+			throw IOError("Write error");
 	}
 
 }
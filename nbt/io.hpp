@@ -25,31 +25,210 @@
 #pragma once
 
 #include "tag.hpp"
-#include <QIODevice>
-#include <QVariant>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
 #include <utility>
 
 namespace nbt {
 
-	NamedTag read_named_binary(QIODevice *file);
-	Tag read_unnamed_binary(QIODevice *file);
+	// default for ReadOptions::max_depth, and the limit nbt::validate holds input to
+	constexpr int MAX_DEPTH = 1024;
 
-	void write_named_binary(QIODevice *file, const NamedTag &tag);
-	void write_unnamed_binary(QIODevice *file, const Tag &tag);
+	enum class ErrorCode : uint8_t {
+		NONE,
+		END_OF_INPUT,
+		INVALID_TAG_ID,
+		NEGATIVE_LENGTH,
+		MAX_DEPTH_REACHED,
+		// a name or string holds a four-byte sequence, which Modified UTF-8 never has
+		INVALID_STRING,
+		// the file, device or compressed stream itself could not be read
+		BAD_INPUT,
+	};
+
+	// How a non-throwing read went.
+	struct ReadStatus {
+		ErrorCode code = ErrorCode::NONE;
+		// bytes of decompressed input consumed before the problem was found
+		size_t offset = 0;
+		// what the throwing API would have said, empty on success
+		std::string message;
+
+		bool ok() const {
+			return code == ErrorCode::NONE;
+		}
+	};
+
+	// the message an IOError carries for error
+	const char *describe(ErrorCode error);
+
+	struct ReadOptions {
+		// Leave compound and list payloads undecoded until nbt::materialize is called on them. Span input must outlive
+		// the result; other inputs are kept alive by the deferred tags themselves.
+		bool lazy = false;
+		// Where every container in the tree is allocated from, or the default resource if null. Must outlive the tree;
+		// see Document.
+		std::pmr::memory_resource *memory = nullptr;
+		// Where compound keys are interned, or a table private to the read if null. Sharing one between reads lets
+		// every chunk of a world point at the same strings. Unless it was made with KeyLifetime::OWN, the keys point
+		// into the table without counting references, so it must outlive the trees read with it, though not copies.
+		KeyTable *keys = nullptr;
+		// How deeply lists and compounds may nest before the input is rejected. Decoding and freeing a tree keep their
+		// own stacks rather than recursing, so this guards against hostile input, not against running out of native
+		// stack; encoding still recurses, though.
+		int max_depth = MAX_DEPTH;
+		// Leave strings that read the same in UTF-8 as borrowed views of the input rather than copying them out, for
+		// read-only work over many chunks. Honoured for span input, which must then outlive the tree, and by
+		// read_named_document, which keeps whatever it read alive itself; other reads copy as usual.
+		bool borrow_strings = false;
+		// Decode a large compound root on up to this many threads, or one per core if not positive. A first pass finds
+		// where each of its entries, and each run of items in its longer lists, starts and ends; those pieces are then
+		// decoded side by side and put back together in order. Compressed and stream input is read into memory in full
+		// for it. Lazy reads, and reads into a memory resource, which need not be safe to share, stay on one thread.
+		int threads = 1;
+	};
+
+	// options, interning keys into fallback unless they already name a table, so that a batch of reads shares one.
+	ReadOptions with_keys(const ReadOptions &options, KeyTable &fallback);
+
+	// A named tag whose containers, strings and keys all live in one arena, so that decoding allocates by bumping a
+	// pointer into a few large blocks and the whole tree is released at once. It also keeps alive the input its strings
+	// were borrowed from, if they were. A tree read in whole and only reached through the const root() goes with the
+	// arena without being taken apart tag by tag; the mutable root() can put in tags with memory of their own, so once
+	// it is called the tree is torn down as usual. Copies of tags taken out of it use the default resource and own all
+	// their strings.
+	class Document {
+	public:
+		Document() : state(std::make_unique<State>()) {}
+
+		// input is kept for as long as the document, for strings borrowed from it
+		explicit Document(std::shared_ptr<const void> input) : Document() {
+			state->input = std::move(input);
+		}
+
+		NamedTag &root() {
+			state->arena_only = false;
+			return state->root;
+		}
+
+		const NamedTag &root() const {
+			return state->root;
+		}
+
+		std::pmr::memory_resource *memory() const {
+			return &state->arena;
+		}
+
+		// where the keys of a tree read into the document are interned, from one thread at a time
+		KeyTable *keys() const {
+			return &state->keys;
+		}
+
+		// a copy of the tree that depends on nothing the document holds
+		NamedTag to_owned() const {
+			return state->root;
+		}
+
+	private:
+		friend Document read_named_document(std::istream &input, ReadOptions options);
+		friend Document read_named_document(std::span<const std::byte> data, ReadOptions options);
+		friend Document read_named_document(const std::filesystem::path &path, ReadOptions options);
+
+		// kept together so that however a document is moved or replaced, its tree always goes before its keys, arena
+		// and input
+		struct State {
+			std::shared_ptr<const void> input;
+			std::pmr::monotonic_buffer_resource arena;
+			KeyTable keys{false, KeyLifetime::TABLE, &arena};
+			NamedTag root;
+			// whether everything the tree holds is in the arena, the key table or the input
+			bool arena_only = false;
+
+			~State() {
+				if (arena_only)
+					root.tag.abandon();
+			}
+		};
+
+		std::unique_ptr<State> state;
+
+		// A document that borrows its strings from data, inflating it first if need be. It keeps owner, or the inflated
+		// copy, alive in place of the caller.
+		static Document read_borrowing(
+			std::span<const std::byte> data, std::shared_ptr<const void> owner, ReadOptions options);
+
+		// Sets the root to what decode reads with options pointed at the arena and keys, noting whether it needs no
+		// teardown of its own.
+		template <typename Decode> void read_root(ReadOptions options, Decode decode);
+	};
+
+	// gzip and zlib input is detected and inflated on the fly
+	NamedTag read_named_binary(std::istream &input, const ReadOptions &options = {});
+	Tag read_unnamed_binary(std::istream &input, const ReadOptions &options = {});
+	NamedTag read_named_binary(std::span<const std::byte> data, const ReadOptions &options = {});
+	Tag read_unnamed_binary(std::span<const std::byte> data, const ReadOptions &options = {});
+	// owner keeps data alive for as long as deferred tags from a lazy read point into it
+	NamedTag read_named_binary(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, const ReadOptions &options = {});
+	Tag read_unnamed_binary(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, const ReadOptions &options = {});
+	// decodes straight out of a memory mapping of the file at path
+	NamedTag read_named_binary(const std::filesystem::path &path, const ReadOptions &options = {});
+	Tag read_unnamed_binary(const std::filesystem::path &path, const ReadOptions &options = {});
+
+	// Counterparts of the above for input that is often broken, such as truncated chunks: failure comes back in status
+	// rather than as an IOError. The decoder reports its own errors without throwing at all; only a failure of the
+	// input itself, such as a corrupt compressed stream, goes through an exception, which is caught before returning.
+	std::optional<NamedTag> try_read_named_binary(
+		std::istream &input, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<Tag> try_read_unnamed_binary(
+		std::istream &input, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<NamedTag> try_read_named_binary(
+		std::span<const std::byte> data, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<Tag> try_read_unnamed_binary(
+		std::span<const std::byte> data, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<NamedTag> try_read_named_binary(std::span<const std::byte> data, std::shared_ptr<const void> owner,
+		ReadStatus &status, const ReadOptions &options = {});
+	std::optional<Tag> try_read_unnamed_binary(std::span<const std::byte> data, std::shared_ptr<const void> owner,
+		ReadStatus &status, const ReadOptions &options = {});
+	std::optional<NamedTag> try_read_named_binary(
+		const std::filesystem::path &path, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<Tag> try_read_unnamed_binary(
+		const std::filesystem::path &path, ReadStatus &status, const ReadOptions &options = {});
+
+	// Borrowing strings, the document keeps its input alive, except for uncompressed span input, which the caller must.
+	Document read_named_document(std::istream &input, ReadOptions options = {});
+	Document read_named_document(std::span<const std::byte> data, ReadOptions options = {});
+	Document read_named_document(const std::filesystem::path &path, ReadOptions options = {});
+
+	// Decode a deferred tag left by a lazy read, one level deep: its own children stay deferred.
+	void materialize(Tag &tag);
+
+	// the whole tree is encoded into one buffer of exactly the right size, then written out at once
+	void write_named_binary(std::ostream &output, const NamedTag &tag);
+	void write_unnamed_binary(std::ostream &output, const Tag &tag);
+
+	// exact number of bytes the tag encodes to
+	size_t named_binary_size(const NamedTag &tag);
+	size_t unnamed_binary_size(const Tag &tag);
 
 	class IOError : public std::exception {
 	public:
 		IOError() = default;
-		explicit IOError(const QString &message) : message(std::move(message.toUtf8())) {}
+		explicit IOError(std::string message) : message(std::move(message)) {}
 
 		const char *what() const noexcept override {
-			return message.constData();
+			return message.c_str();
 		}
 
 	private:
 		// used simply for ownership
-		const QByteArray message;
+		const std::string message;
 	};
 
 }
@@ -0,0 +1,103 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "key.hpp"
+#include "mutf8.hpp"
+
+#include <mutex>
+
+namespace nbt {
+
+	static std::atomic<uint64_t> next_table_id = 1;
+
+	KeyTable::KeyTable(bool concurrent, KeyLifetime lifetime, std::pmr::memory_resource *memory)
+		: concurrent(concurrent), lifetime(lifetime), id(next_table_id.fetch_add(1, std::memory_order_relaxed)),
+		  memory(memory), keys(memory) {}
+
+	// pinned text belongs to the table, while counted text goes once the last key holding it does
+	KeyTable::~KeyTable() {
+		if (lifetime == KeyLifetime::TABLE) {
+			for (auto &[name, key] : keys)
+				Key::destroy(std::exchange(key.node, nullptr));
+		}
+	}
+
+	Key KeyTable::intern(std::string_view name) {
+		if (!concurrent) {
+			const auto existing = keys.find(name);
+			return hand_out(existing != keys.end() ? existing->second.node : add(name).second.node);
+		}
+
+		Cache &local = cache();
+		if (local.table != id) {
+			local.nodes.clear();
+			local.table = id;
+		}
+
+		const auto cached = local.nodes.find(name);
+		if (cached != local.nodes.end())
+			return hand_out(cached->second);
+
+		const std::pair<const std::pmr::string, Key> *entry = nullptr;
+		{
+			const std::shared_lock lock(mutex);
+			const auto existing = keys.find(name);
+			if (existing != keys.end())
+				entry = &*existing;
+		}
+
+		if (entry == nullptr) {
+			const std::unique_lock lock(mutex);
+			entry = &add(name);
+		}
+
+		// map nodes stay put, so the name the table holds outlives the view of it cached here
+		local.nodes.try_emplace(entry->first, entry->second.node);
+		return hand_out(entry->second.node);
+	}
+
+	KeyTable::Cache &KeyTable::cache() {
+		thread_local Cache local;
+		return local;
+	}
+
+	// A key made here is counted until it is in the table, so that nothing leaks if adding it throws; if another
+	// thread got there first its key wins and this one is dropped.
+	const std::pair<const std::pmr::string, Key> &KeyTable::add(std::string_view name) {
+		const auto [entry, added] =
+			keys.try_emplace(std::pmr::string(name, memory), Key(Key::make(from_mutf8(name, memory))));
+		if (added && lifetime == KeyLifetime::TABLE)
+			entry->second.node->references.store(Key::PINNED, std::memory_order_relaxed);
+
+		return *entry;
+	}
+
+	Key KeyTable::hand_out(Key::Node *node) const {
+		if (lifetime == KeyLifetime::OWN)
+			node->references.fetch_add(1, std::memory_order_relaxed);
+
+		return Key(node);
+	}
+
+}
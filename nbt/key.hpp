@@ -0,0 +1,175 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace nbt {
+
+	// Name of a compound entry: a single pointer to text shared by every key interned from the same name, so equal
+	// names compare by pointer and a chunk holding thousands of "id"s stores it once. Keys from a KeyTable that lives
+	// longer than their tree are pinned to it and copy by pointer alone; any other key counts references to its text.
+	// A copy of a pinned key owns its text instead, so that a copied tree never depends on the table.
+	class Key {
+	public:
+		Key() = default;
+
+		Key(std::string_view name) : node(make(std::pmr::string(name))) {}
+
+		Key(const std::string &name) : Key(std::string_view(name)) {}
+
+		Key(const char *name) : Key(std::string_view(name)) {}
+
+		Key(const Key &other) {
+			if (other.node == nullptr)
+				return;
+
+			if (other.node->references.load(std::memory_order_relaxed) == PINNED) {
+				node = make(std::pmr::string(other.node->text));
+			} else {
+				other.node->references.fetch_add(1, std::memory_order_relaxed);
+				node = other.node;
+			}
+		}
+
+		Key(Key &&other) noexcept : node(std::exchange(other.node, nullptr)) {}
+
+		Key &operator=(Key other) noexcept {
+			std::swap(node, other.node);
+			return *this;
+		}
+
+		~Key() {
+			if (node != nullptr && node->references.load(std::memory_order_relaxed) != PINNED &&
+				node->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				destroy(node);
+		}
+
+		std::string_view str() const {
+			return node != nullptr ? std::string_view(node->text) : std::string_view();
+		}
+
+		operator std::string_view() const {
+			return str();
+		}
+
+		bool operator==(const Key &other) const {
+			return node == other.node || str() == other.str();
+		}
+
+	private:
+		friend class KeyTable;
+
+		// reference count of text a table keeps to itself
+		static constexpr size_t PINNED = std::numeric_limits<size_t>::max();
+
+		// allocated from the same resource as its text
+		struct Node {
+			std::atomic<size_t> references;
+			const std::pmr::string text;
+		};
+
+		Node *node = nullptr;
+
+		// takes over a reference to node, or points at it if it is pinned
+		explicit Key(Node *node) : node(node) {}
+
+		// a node holding text with one reference to it
+		static Node *make(std::pmr::string text) {
+			std::pmr::polymorphic_allocator<> allocator(text.get_allocator());
+			return allocator.new_object<Node>(1, std::move(text));
+		}
+
+		static void destroy(Node *node) {
+			std::pmr::polymorphic_allocator<> allocator(node->text.get_allocator());
+			allocator.delete_object(node);
+		}
+	};
+
+	// How long the keys a KeyTable hands out stay valid.
+	enum class KeyLifetime {
+		TABLE, // as long as the table, which then has to outlive every tree read with it
+		OWN, // however long they are kept, at the cost of counting references to each
+	};
+
+	// Map from encoded names to their keys, shared by every decode it is passed to. Thread-safe unless made for a
+	// single thread, which saves taking a lock for every name. Each thread also keeps the names it has looked up in a
+	// thread-safe table in front of it, so that once a name is known the lookup takes no lock either. The table and
+	// the text of its keys are allocated from memory, which has to outlive any key that does.
+	class KeyTable {
+	public:
+		explicit KeyTable(bool concurrent = true, KeyLifetime lifetime = KeyLifetime::TABLE,
+			std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+		KeyTable(const KeyTable &) = delete;
+		KeyTable &operator=(const KeyTable &) = delete;
+		~KeyTable();
+
+		// The key for a name as stored in the file, in Modified UTF-8, converting and allocating it only the first time
+		// it is seen.
+		Key intern(std::string_view name);
+
+		// whether several threads may intern into the table without sharing the reference counts of its keys
+		bool shareable() const {
+			return concurrent && lifetime == KeyLifetime::TABLE;
+		}
+
+	private:
+		struct Hash {
+			using is_transparent = void;
+
+			size_t operator()(std::string_view value) const {
+				return std::hash<std::string_view>()(value);
+			}
+		};
+
+		// what one thread has looked up in a thread-safe table, by the name as the table holds it
+		struct Cache {
+			uint64_t table = 0;
+			std::unordered_map<std::string_view, Key::Node *, Hash, std::equal_to<>> nodes;
+		};
+
+		const bool concurrent;
+		const KeyLifetime lifetime;
+		const uint64_t id; // never reused, so that a cache cannot mistake a new table for one gone before
+		std::shared_mutex mutex;
+		std::pmr::memory_resource *const memory;
+		std::pmr::unordered_map<std::pmr::string, Key, Hash, std::equal_to<>> keys;
+
+		static Cache &cache();
+		// the entry for name, adding it if it is missing; the caller holds whatever lock the table needs
+		const std::pair<const std::pmr::string, Key> &add(std::string_view name);
+		Key hand_out(Key::Node *node) const;
+	};
+
+}
@@ -0,0 +1,132 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mapped_file.hpp"
+#include "io.hpp"
+
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace nbt {
+
+#ifdef _WIN32
+
+	static IOError system_error(const std::filesystem::path &path, DWORD error = GetLastError()) {
+		return IOError("Cannot map " + path.string() + ": error " + std::to_string(error));
+	}
+
+	MappedFile::MappedFile(const std::filesystem::path &path) {
+		const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw system_error(path);
+
+		LARGE_INTEGER length;
+		if (!GetFileSizeEx(file, &length)) {
+			const DWORD error = GetLastError();
+			CloseHandle(file);
+			throw system_error(path, error);
+		}
+
+		// an empty file cannot be mapped, but is still a valid (if useless) input
+		if (length.QuadPart == 0) {
+			CloseHandle(file);
+			return;
+		}
+
+		// the view keeps the file open by itself, so neither handle is needed past this point
+		const HANDLE view = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (view != nullptr) {
+			mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(view);
+		}
+
+		const DWORD error = GetLastError();
+		CloseHandle(file);
+		if (mapping == nullptr)
+			throw system_error(path, error);
+
+		size = static_cast<size_t>(length.QuadPart);
+	}
+
+	MappedFile::~MappedFile() {
+		if (mapping != nullptr)
+			UnmapViewOfFile(mapping);
+	}
+
+#else
+
+	static IOError system_error(const std::filesystem::path &path, int error = errno) {
+		return IOError("Cannot map " + path.string() + ": " + std::strerror(error));
+	}
+
+	MappedFile::MappedFile(const std::filesystem::path &path) {
+		const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+			throw system_error(path);
+
+		struct stat status;
+		if (fstat(file, &status) != 0) {
+			const int error = errno;
+			close(file);
+			throw system_error(path, error);
+		}
+
+		// an empty file cannot be mapped, but is still a valid (if useless) input
+		if (status.st_size == 0) {
+			close(file);
+			return;
+		}
+
+		// the mapping keeps the file open by itself
+		void *result = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+		const int error = errno;
+		close(file);
+		if (result == MAP_FAILED)
+			throw system_error(path, error);
+
+		mapping = result;
+		size = static_cast<size_t>(status.st_size);
+	}
+
+	MappedFile::~MappedFile() {
+		if (mapping != nullptr)
+			munmap(mapping, size);
+	}
+
+#endif
+
+}
@@ -0,0 +1,218 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mutf8.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace nbt {
+
+	static bool is_continuation(uint8_t byte) {
+		return (byte & 0xC0) == 0x80;
+	}
+
+	bool is_plain_ascii(std::string_view text) {
+		const char *bytes = text.data();
+		const size_t length = text.size();
+		size_t i = 0;
+
+#if defined(__SSE2__)
+		// SSE2 is always there on x86-64, so unlike the byte swap kernels this needs no runtime check
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= length; i += 16) {
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+			// high bits mark bytes past ASCII, and comparing with zero sets them for NULs too
+			if (_mm_movemask_epi8(_mm_or_si128(block, _mm_cmpeq_epi8(block, zero))) != 0)
+				return false;
+		}
+#endif
+
+		constexpr uint64_t ONES = 0x0101010101010101ULL;
+		constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+		for (; i + 8 <= length; i += 8) {
+			uint64_t block;
+			memcpy(&block, bytes + i, sizeof(block));
+			// (block - ONES) & ~block has the high bit set in some byte if and only if one of them is zero
+			if (((block | ((block - ONES) & ~block)) & HIGHS) != 0)
+				return false;
+		}
+
+		for (; i < length; ++i) {
+			const auto byte = static_cast<uint8_t>(bytes[i]);
+			if (byte == 0 || byte >= 0x80)
+				return false;
+		}
+
+		return true;
+	}
+
+	// The supplementary character a surrogate pair at bytes encodes, or 0 if there is not one there.
+	static uint32_t surrogate_pair(const uint8_t *bytes, size_t available) {
+		if (available < 6 || bytes[0] != 0xED || (bytes[1] & 0xF0) != 0xA0 || !is_continuation(bytes[2]) ||
+			bytes[3] != 0xED || (bytes[4] & 0xF0) != 0xB0 || !is_continuation(bytes[5]))
+			return 0;
+
+		const uint32_t high = ((bytes[1] & 0x0F) << 6) | (bytes[2] & 0x3F);
+		const uint32_t low = ((bytes[4] & 0x0F) << 6) | (bytes[5] & 0x3F);
+		return 0x10000 + (high << 10) + low;
+	}
+
+	// The character past U+FFFF a four-byte sequence at bytes encodes, or 0 if there is not one there.
+	static uint32_t supplementary(const uint8_t *bytes, size_t available) {
+		if (available < 4 || bytes[0] < 0xF0 || bytes[0] > 0xF4 || !is_continuation(bytes[1]) ||
+			!is_continuation(bytes[2]) || !is_continuation(bytes[3]))
+			return 0;
+
+		const uint32_t code_point = ((bytes[0] & 0x07) << 18) | ((bytes[1] & 0x3F) << 12) |
+			((bytes[2] & 0x3F) << 6) | (bytes[3] & 0x3F);
+		return code_point >= 0x10000 && code_point <= 0x10FFFF ? code_point : 0;
+	}
+
+	bool same_in_utf8(std::string_view encoded) {
+		if (is_plain_ascii(encoded))
+			return true;
+
+		// C0 leads nothing but an encoded NUL, and ED nothing but surrogates and a few characters before them
+		for (const char c : encoded) {
+			const auto byte = static_cast<uint8_t>(c);
+			if (byte == 0xC0 || byte == 0xED)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool may_be_mutf8(std::string_view encoded) {
+		if (is_plain_ascii(encoded))
+			return true;
+
+		for (const char c : encoded) {
+			if (static_cast<uint8_t>(c) >= 0xF0)
+				return false;
+		}
+
+		return true;
+	}
+
+	// result, empty, filled with encoded converted to UTF-8
+	template <typename Text> static Text decode(std::string_view encoded, Text result) {
+		if (is_plain_ascii(encoded)) {
+			result.assign(encoded);
+			return result;
+		}
+
+		const auto *bytes = reinterpret_cast<const uint8_t *>(encoded.data());
+		const size_t length = encoded.size();
+		// never longer than the input: C0 80 shrinks to one byte and a pair of surrogates from six to four
+		result.reserve(length);
+
+		for (size_t i = 0; i < length;) {
+			if (bytes[i] == 0xC0 && i + 1 < length && bytes[i + 1] == 0x80) {
+				result += '\0';
+				i += 2;
+			} else if (const uint32_t code_point = surrogate_pair(bytes + i, length - i)) {
+				result += static_cast<char>(0xF0 | (code_point >> 18));
+				result += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+				result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (code_point & 0x3F));
+				i += 6;
+			} else {
+				result += static_cast<char>(bytes[i]);
+				++i;
+			}
+		}
+
+		return result;
+	}
+
+	std::string from_mutf8(std::string_view encoded) {
+		return decode(encoded, std::string());
+	}
+
+	std::pmr::string from_mutf8(std::string_view encoded, std::pmr::memory_resource *memory) {
+		return decode(encoded, std::pmr::string(memory));
+	}
+
+	static void append_surrogate(std::string &result, uint32_t unit) {
+		result += static_cast<char>(0xE0 | (unit >> 12));
+		result += static_cast<char>(0x80 | ((unit >> 6) & 0x3F));
+		result += static_cast<char>(0x80 | (unit & 0x3F));
+	}
+
+	std::string to_mutf8(std::string_view text) {
+		if (is_plain_ascii(text))
+			return std::string(text);
+
+		const auto *bytes = reinterpret_cast<const uint8_t *>(text.data());
+		const size_t length = text.size();
+		std::string result;
+		result.reserve(mutf8_size(text));
+
+		for (size_t i = 0; i < length;) {
+			if (bytes[i] == 0) {
+				result += static_cast<char>(0xC0);
+				result += static_cast<char>(0x80);
+				++i;
+			} else if (const uint32_t code_point = supplementary(bytes + i, length - i)) {
+				append_surrogate(result, 0xD800 + ((code_point - 0x10000) >> 10));
+				append_surrogate(result, 0xDC00 + ((code_point - 0x10000) & 0x3FF));
+				i += 4;
+			} else {
+				result += static_cast<char>(bytes[i]);
+				++i;
+			}
+		}
+
+		return result;
+	}
+
+	size_t mutf8_size(std::string_view text) {
+		if (is_plain_ascii(text))
+			return text.size();
+
+		const auto *bytes = reinterpret_cast<const uint8_t *>(text.data());
+		const size_t length = text.size();
+		size_t size = length;
+
+		for (size_t i = 0; i < length;) {
+			if (bytes[i] == 0) {
+				++size;
+				++i;
+			} else if (supplementary(bytes + i, length - i) != 0) {
+				size += 2;
+				i += 4;
+			} else {
+				++i;
+			}
+		}
+
+		return size;
+	}
+
+}
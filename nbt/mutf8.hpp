@@ -0,0 +1,59 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+namespace nbt {
+
+	// NBT strings are stored in Java's Modified UTF-8, which differs from UTF-8 in writing NUL as C0 80 and characters
+	// past U+FFFF as a pair of three-byte surrogates. In memory, strings and keys are UTF-8, converted on the way in
+	// and out. Bytes that belong to neither form, such as a lone surrogate, are passed through as they are, so that
+	// nothing is lost on a round trip. The exception is the four-byte sequences of UTF-8, which Modified UTF-8 never
+	// has: to_mutf8 writes them as surrogate pairs, so input holding them raw is rejected rather than changed.
+
+	// Whether text is all ASCII other than NUL, which is the same in both encodings and so needs no conversion. This is
+	// nearly every string in practice, and is checked a vector at a time.
+	bool is_plain_ascii(std::string_view text);
+
+	// Whether from_mutf8(encoded) is encoded as it is, so that the bytes can be used without converting them. This
+	// holds for any text without C0 or ED bytes, the leads of an encoded NUL and of surrogates.
+	bool same_in_utf8(std::string_view encoded);
+
+	// Whether encoded is free of the bytes F0 and up, which lead four-byte sequences and never appear in Modified
+	// UTF-8. Decoders check every name and string with this before using it.
+	bool may_be_mutf8(std::string_view encoded);
+
+	std::string from_mutf8(std::string_view encoded);
+	// from_mutf8, allocated from memory
+	std::pmr::string from_mutf8(std::string_view encoded, std::pmr::memory_resource *memory);
+	std::string to_mutf8(std::string_view text);
+
+	// to_mutf8(text).size(), without building it
+	size_t mutf8_size(std::string_view text);
+
+}
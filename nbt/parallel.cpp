@@ -0,0 +1,82 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nbt {
+
+	void parallel_for(size_t count, int threads, const std::function<void(size_t index)> &body) {
+		if (threads <= 0)
+			threads = default_thread_count();
+
+		const size_t worker_count = std::min(static_cast<size_t>(threads), count);
+		if (worker_count <= 1) {
+			for (size_t i = 0; i < count; ++i)
+				body(i);
+			return;
+		}
+
+		std::atomic<size_t> next = 0;
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		const auto work = [&] {
+			size_t index;
+			while ((index = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+				try {
+					body(index);
+				} catch (...) {
+					const std::lock_guard lock(error_mutex);
+					if (error == nullptr)
+						error = std::current_exception();
+					next.store(count, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(worker_count - 1);
+		for (size_t i = 1; i < worker_count; ++i)
+			workers.emplace_back(work);
+
+		work();
+		for (std::thread &worker : workers)
+			worker.join();
+
+		if (error != nullptr)
+			std::rethrow_exception(error);
+	}
+
+	int default_thread_count() {
+		return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+}
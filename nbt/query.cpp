@@ -0,0 +1,595 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "query.hpp"
+#include "inflate.hpp"
+#include "mapped_file.hpp"
+#include "mutf8.hpp"
+#include "reader.hpp"
+#include "source.hpp"
+#include "walker.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace nbt {
+
+	using Kind = Query::Step::Kind;
+
+	// Reads a query as it is written, throwing QueryError at the first thing that does not fit.
+	class QueryParser {
+	public:
+		explicit QueryParser(std::string_view expression) : text(expression) {}
+
+		std::vector<Query::Step> parse() {
+			std::vector<Query::Step> steps;
+			while (position < text.size()) {
+				if (text[position] == '[') {
+					++position;
+					steps.push_back(bracket());
+					expect(']');
+					continue;
+				}
+
+				if (!steps.empty())
+					expect('.');
+
+				if (position < text.size() && text[position] == '*') {
+					++position;
+					steps.push_back({.kind = Kind::ANY_ENTRY});
+				} else {
+					steps.push_back({.kind = Kind::NAME, .name = name()});
+				}
+			}
+
+			return steps;
+		}
+
+	private:
+		std::string text;
+		size_t position = 0;
+
+		Query::Step bracket() {
+			skip_spaces();
+			if (position == text.size())
+				fail("Expected *, ? or an index");
+
+			const char first = text[position];
+			if (first == '*') {
+				++position;
+				skip_spaces();
+				return {.kind = Kind::ANY_ITEM};
+			}
+
+			if (first == '?') {
+				++position;
+				skip_spaces();
+				Query::Step step = {.kind = Kind::FILTER, .name = name()};
+				skip_spaces();
+				if (text.compare(position, 2, "==") == 0) {
+					position += 2;
+					skip_spaces();
+					step.value = literal();
+					skip_spaces();
+				}
+
+				return step;
+			}
+
+			int32_t index = 0;
+			const char *end = text.data() + text.size();
+			const auto [next, error] = std::from_chars(text.data() + position, end, index);
+			if (error != std::errc() || index < 0)
+				fail("Expected *, ? or an index");
+
+			position = next - text.data();
+			skip_spaces();
+			return {.kind = Kind::INDEX, .index = index};
+		}
+
+		std::string name() {
+			if (position < text.size() && text[position] == '"')
+				return quoted();
+
+			const size_t start = position;
+			while (position < text.size() && std::string_view(".[]=\" ").find(text[position]) == std::string_view::npos)
+				++position;
+
+			if (position == start)
+				fail("Expected a name");
+
+			return text.substr(start, position - start);
+		}
+
+		// a string in double quotes, in which a backslash takes the next character as it is
+		std::string quoted() {
+			std::string result;
+			++position;
+
+			while (true) {
+				if (position == text.size())
+					fail("Unterminated string");
+
+				char c = text[position++];
+				if (c == '"')
+					return result;
+
+				if (c == '\\') {
+					if (position == text.size())
+						fail("Unterminated string");
+					c = text[position++];
+				}
+
+				result += c;
+			}
+		}
+
+		Query::Value literal() {
+			if (position < text.size() && text[position] == '"')
+				return quoted();
+
+			const size_t start = position;
+			constexpr std::string_view NUMBER_CHARACTERS = "+-.0123456789eE";
+			while (position < text.size() && NUMBER_CHARACTERS.find(text[position]) != std::string_view::npos)
+				++position;
+
+			const char *begin = text.data() + start;
+			const char *end = text.data() + position;
+
+			Long integer = 0;
+			if (const auto [next, error] = std::from_chars(begin, end, integer); error == std::errc() && next == end)
+				return integer;
+
+			Double real = 0;
+			if (const auto [next, error] = std::from_chars(begin, end, real); error == std::errc() && next == end)
+				return real;
+
+			position = start;
+			fail("Expected a string or a number");
+		}
+
+		void expect(char c) {
+			if (position == text.size() || text[position] != c)
+				fail(std::string("Expected '") + c + "'");
+
+			++position;
+		}
+
+		void skip_spaces() {
+			while (position < text.size() && text[position] == ' ')
+				++position;
+		}
+
+		[[noreturn]] void fail(const std::string &what) const {
+			throw QueryError(what + " at position " + std::to_string(position) + " of query");
+		}
+	};
+
+	Query::Query(std::string_view expression) : m_steps(QueryParser(expression).parse()) {}
+
+	bool Query::single() const {
+		return std::all_of(m_steps.begin(), m_steps.end(),
+			[](const Step &step) { return step.kind == Kind::NAME || step.kind == Kind::INDEX; });
+	}
+
+	template <typename T> static bool equals(const Query::Value &literal, T value) {
+		if constexpr (std::is_same_v<T, std::string_view>) {
+			const std::string *text = std::get_if<std::string>(&literal);
+			return text != nullptr && *text == value;
+		} else {
+			if (const Long *number = std::get_if<Long>(&literal)) {
+				if constexpr (std::is_integral_v<T>)
+					return *number == value;
+				else
+					return static_cast<Double>(*number) == value;
+			}
+
+			if (const Double *number = std::get_if<Double>(&literal))
+				return *number == static_cast<Double>(value);
+
+			return false;
+		}
+	}
+
+	static bool equals(const Query::Value &literal, const Tag &tag) {
+		switch (tag.type()) {
+			case TagType::BYTE:
+				return equals(literal, tag.byte_value());
+			case TagType::SHORT:
+				return equals(literal, tag.short_value());
+			case TagType::INT:
+				return equals(literal, tag.int_value());
+			case TagType::LONG:
+				return equals(literal, tag.long_value());
+			case TagType::FLOAT:
+				return equals(literal, tag.float_value());
+			case TagType::DOUBLE:
+				return equals(literal, tag.double_value());
+			case TagType::STRING:
+				return equals(literal, tag.string_text());
+			default:
+				return false;
+		}
+	}
+
+	// whether a decoded list item passes filter
+	static bool passes(const Tag &item, const Query::Step &filter) {
+		if (item.type() != TagType::COMPOUND)
+			return false;
+
+		const Tag *entry = item.find(filter.name);
+		if (entry == nullptr)
+			return false;
+
+		return std::holds_alternative<std::monostate>(filter.value) || equals(filter.value, *entry);
+	}
+
+	// Decodes every level of a tag that was left deferred.
+	static void materialize_tree(Tag &tag) {
+		std::vector<Tag *> pending = {&tag};
+
+		while (!pending.empty()) {
+			Tag &next = *pending.back();
+			pending.pop_back();
+			materialize(next);
+
+			if (next.type() == TagType::COMPOUND) {
+				for (NamedTag &entry : next.compound_value())
+					pending.push_back(&entry.tag);
+			} else if (next.type() == TagType::LIST) {
+				for (Tag &item : next.list_value())
+					pending.push_back(&item);
+			}
+		}
+	}
+
+	// Follows a query through a walk, going into only the lists and compounds on its path and building only the tags
+	// at its end. Matches under a list item that has yet to pass a filter are kept provisionally, and dropped again if
+	// the item ends without passing.
+	class QueryWalk final : public Visitor {
+	public:
+		QueryWalk(const Query &query, std::vector<Tag> &results)
+			: steps(query.steps()), single(query.single()), results(results) {
+			// names and strings come from the walk undecoded, so what they are compared with is encoded to match
+			for (const Query::Step &step : steps) {
+				const std::string *text = std::get_if<std::string>(&step.value);
+				encoded.push_back({to_mutf8(step.name), text != nullptr ? to_mutf8(*text) : std::string()});
+			}
+		}
+
+		Visit key(std::string_view name) override {
+			if (done)
+				return Visit::STOP;
+
+			// the root's name is not part of the path
+			if (stack.empty())
+				return Visit::ENTER;
+
+			Frame &top = stack.back();
+			const Query::Step &step = steps[top.step];
+			slot = {};
+
+			if (step.kind == Kind::ANY_ENTRY || (step.kind == Kind::NAME && name == encoded[top.step].name))
+				slot = {true, top.step + 1};
+
+			if (top.filter != nullptr && name == encoding(*top.filter).name) {
+				if (std::holds_alternative<std::monostate>(top.filter->value))
+					top.filter = nullptr;
+				else
+					slot.tested = true;
+			}
+
+			return slot.matched || slot.tested ? Visit::ENTER : Visit::SKIP;
+		}
+
+		Visit begin_compound() override {
+			if (done)
+				return Visit::STOP;
+
+			const Slot at = next();
+			if (!at.matched)
+				return Visit::SKIP;
+
+			if (at.step == steps.size())
+				return capture(at);
+
+			const Kind kind = steps[at.step].kind;
+			if (kind != Kind::NAME && kind != Kind::ANY_ENTRY)
+				return Visit::SKIP;
+
+			stack.push_back({false, at.step, 0, at.filtered ? &steps[at.step - 1] : nullptr, results.size()});
+			return Visit::ENTER;
+		}
+
+		Visit begin_list(TagType item_type, int32_t length) override {
+			if (done)
+				return Visit::STOP;
+
+			const Slot at = next();
+			if (!at.matched)
+				return Visit::SKIP;
+
+			if (at.step == steps.size())
+				return capture(at);
+
+			// a list only gets entered when some item in it can match
+			const Query::Step &step = steps[at.step];
+			const bool reachable = step.kind == Kind::ANY_ITEM || (step.kind == Kind::INDEX && step.index < length) ||
+								   (step.kind == Kind::FILTER && item_type == TagType::COMPOUND);
+			if (!reachable)
+				return Visit::SKIP;
+
+			stack.push_back({true, at.step, 0, nullptr, results.size()});
+			return Visit::ENTER;
+		}
+
+		Visit begin_array(TagType type, int32_t length) override {
+			if (done)
+				return Visit::STOP;
+
+			const Slot at = next();
+			if (!at.matched || at.step != steps.size())
+				return Visit::SKIP;
+
+			if (type == TagType::BYTE_ARRAY) {
+				array = Tag::of_byte_array();
+				array.byte_array_value().reserve(length);
+			} else if (type == TagType::INT_ARRAY) {
+				array = Tag::of_int_array();
+				array.int_array_value().reserve(length);
+			} else {
+				array = Tag::of_long_array();
+				array.long_array_value().reserve(length);
+			}
+
+			return Visit::ENTER;
+		}
+
+		void array_chunk(std::span<const Byte> values) override {
+			ByteArray &target = array.byte_array_value();
+			target.insert(target.end(), values.begin(), values.end());
+		}
+
+		void array_chunk(std::span<const Int> values) override {
+			IntArray &target = array.int_array_value();
+			target.insert(target.end(), values.begin(), values.end());
+		}
+
+		void array_chunk(std::span<const Long> values) override {
+			LongArray &target = array.long_array_value();
+			target.insert(target.end(), values.begin(), values.end());
+		}
+
+		void end() override {
+			if (array.type() != TagType::END) {
+				add(std::move(array));
+				array = {};
+				return;
+			}
+
+			const Frame closed = stack.back();
+			stack.pop_back();
+			if (closed.filter != nullptr)
+				results.erase(results.begin() + static_cast<ptrdiff_t>(closed.mark), results.end());
+		}
+
+		void byte_value(Byte value) override {
+			scalar(value, Tag::of_byte);
+		}
+
+		void short_value(Short value) override {
+			scalar(value, Tag::of_short);
+		}
+
+		void int_value(Int value) override {
+			scalar(value, Tag::of_int);
+		}
+
+		void long_value(Long value) override {
+			scalar(value, Tag::of_long);
+		}
+
+		void float_value(Float value) override {
+			scalar(value, Tag::of_float);
+		}
+
+		void double_value(Double value) override {
+			scalar(value, Tag::of_double);
+		}
+
+		void string_value(std::string_view value) override {
+			const Slot at = next();
+			const Query::Step *filter = at.tested ? stack.back().filter : nullptr;
+			if (filter != nullptr && std::holds_alternative<std::string>(filter->value) &&
+				value == encoding(*filter).text)
+				stack.back().filter = nullptr;
+
+			if (at.matched && at.step == steps.size())
+				add(Tag::of_string(from_mutf8(value, std::pmr::get_default_resource())));
+		}
+
+		void skipped(TagType type, TagType content_type, std::span<const std::byte> payload, int32_t length) override {
+			if (!capturing)
+				return;
+
+			capturing = false;
+			Tag tag = Tag::of_deferred(type, content_type, {nullptr, payload, length, static_cast<int>(stack.size())});
+			materialize_tree(tag);
+
+			if (capture_filter == nullptr || passes(tag, *capture_filter))
+				add(std::move(tag));
+		}
+
+	private:
+		// A list or compound on the path.
+		struct Frame {
+			bool list;
+			size_t step; // what its entries or items are matched against
+			int32_t index; // of the next item, for lists
+			const Query::Step *filter; // for a list item, the filter it has yet to pass
+			size_t mark; // how many results there were when it opened
+		};
+
+		// What the value about to be reported is to the query.
+		struct Slot {
+			bool matched = false; // by every step before step
+			size_t step = 0;
+			bool filtered = false; // a list item that has to pass the step before step
+			bool tested = false; // the entry a filter looks at
+		};
+
+		// A step's name and string value in Modified UTF-8.
+		struct Encoded {
+			std::string name;
+			std::string text;
+		};
+
+		const std::vector<Query::Step> &steps;
+		std::vector<Encoded> encoded; // one for each step
+		const bool single;
+		std::vector<Tag> &results;
+		std::vector<Frame> stack;
+		Slot slot = {true, 0}; // set by key(), and for the root up front
+		Tag array; // the array being filled, if any
+		bool capturing = false; // whether the skip under way is of a match
+		const Query::Step *capture_filter = nullptr;
+		bool done = false;
+
+		const Encoded &encoding(const Query::Step &step) const {
+			return encoded[static_cast<size_t>(&step - steps.data())];
+		}
+
+		// where the value about to be reported stands, taken from its key or its position in a list
+		Slot next() {
+			if (stack.empty() || !stack.back().list)
+				return std::exchange(slot, {});
+
+			Frame &top = stack.back();
+			const int32_t index = top.index++;
+			const Query::Step &step = steps[top.step];
+
+			switch (step.kind) {
+				case Kind::ANY_ITEM:
+					return {true, top.step + 1};
+				case Kind::INDEX:
+					return {index == step.index, top.step + 1};
+				case Kind::FILTER:
+					return {true, top.step + 1, true};
+				default:
+					return {};
+			}
+		}
+
+		// A list or compound at the end of the path is skipped, then decoded out of the bytes it was skipped over.
+		Visit capture(const Slot &at) {
+			capturing = true;
+			capture_filter = at.filtered ? &steps[at.step - 1] : nullptr;
+			return Visit::SKIP;
+		}
+
+		template <typename T> void scalar(T value, Tag (*make)(T)) {
+			const Slot at = next();
+			if (at.tested && equals(stack.back().filter->value, value))
+				stack.back().filter = nullptr;
+
+			if (at.matched && at.step == steps.size())
+				add(make(value));
+		}
+
+		void add(Tag tag) {
+			results.push_back(std::move(tag));
+			done = single;
+		}
+	};
+
+	std::optional<std::vector<Tag>> try_query_named_binary(
+		std::span<const std::byte> data, const Query &query, ReadStatus &status, const ReadOptions &options) {
+		// matches are decoded out of the bytes they were skipped over, so compressed input is inflated up front
+		std::vector<std::byte> inflated;
+		if (const Compression compression = detect_compression(data); compression != Compression::NONE) {
+			try {
+				SpanSource input(data);
+				inflated = inflate_all(input, compression);
+			} catch (const IOError &error) {
+				status = {ErrorCode::BAD_INPUT, 0, error.what()};
+				return {};
+			} catch (const std::bad_alloc &) {
+				status = {ErrorCode::BAD_INPUT, 0, "Out of memory"};
+				return {};
+			}
+
+			data = inflated;
+		}
+
+		std::vector<Tag> results;
+		Reader reader(data);
+		QueryWalk walk(query, results);
+		Walker<QueryWalk>(reader, walk, options.max_depth).named(0);
+
+		if (reader.failed()) {
+			status = {reader.error(), reader.error_position(), describe(reader.error())};
+			return {};
+		}
+
+		status = {};
+		return results;
+	}
+
+	std::optional<std::vector<Tag>> try_query_named_binary(
+		const std::filesystem::path &path, const Query &query, ReadStatus &status, const ReadOptions &options) {
+		std::optional<MappedFile> file;
+		try {
+			file.emplace(path);
+		} catch (const IOError &error) {
+			status = {ErrorCode::BAD_INPUT, 0, error.what()};
+			return {};
+		}
+
+		return try_query_named_binary(file->data(), query, status, options);
+	}
+
+	std::vector<Tag> query_named_binary(
+		std::span<const std::byte> data, const Query &query, const ReadOptions &options) {
+		ReadStatus status;
+		std::optional<std::vector<Tag>> result = try_query_named_binary(data, query, status, options);
+		if (!result.has_value())
+			throw IOError(status.message);
+
+		return std::move(result.value());
+	}
+
+	std::vector<Tag> query_named_binary(
+		const std::filesystem::path &path, const Query &query, const ReadOptions &options) {
+		ReadStatus status;
+		std::optional<std::vector<Tag>> result = try_query_named_binary(path, query, status, options);
+		if (!result.has_value())
+			throw IOError(status.message);
+
+		return std::move(result.value());
+	}
+
+}
@@ -0,0 +1,101 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "io.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace nbt {
+
+	// A path through nested tags, such as Level.Sections[*].BlockStates or Inventory[?id=="minecraft:diamond"].Count,
+	// starting from the root tag. Names pick compound entries and * every entry; [n] picks the nth list item, [*]
+	// every item, and [?name] or [?name==value] the compound items that have the entry, or have it equal to a string
+	// or number. Names that are not plain words can be written in double quotes.
+	class Query {
+	public:
+		// what a filter compares its entry to, or monostate if having the entry is enough
+		using Value = std::variant<std::monostate, Long, Double, std::string>;
+
+		struct Step {
+			enum class Kind : uint8_t {
+				NAME,
+				ANY_ENTRY,
+				ANY_ITEM,
+				INDEX,
+				FILTER
+			};
+
+			Kind kind = Kind::NAME;
+			std::string name = {}; // UTF-8, for NAME and FILTER
+			int32_t index = 0; // for INDEX
+			Value value = {}; // for FILTER
+		};
+
+		// throws QueryError if expression is malformed
+		explicit Query(std::string_view expression);
+
+		const std::vector<Step> &steps() const {
+			return m_steps;
+		}
+
+		// whether every step picks a single tag, so that the first match is the only one
+		bool single() const;
+
+	private:
+		std::vector<Step> m_steps;
+	};
+
+	// Every tag that query matches within the named tag encoded in data, in file order. Subtrees that cannot match are
+	// skipped by their lengths rather than decoded, and only the matches themselves are built. gzip and zlib input is
+	// inflated first; only ReadOptions::max_depth applies.
+	std::optional<std::vector<Tag>> try_query_named_binary(
+		std::span<const std::byte> data, const Query &query, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<std::vector<Tag>> try_query_named_binary(
+		const std::filesystem::path &path, const Query &query, ReadStatus &status, const ReadOptions &options = {});
+	std::vector<Tag> query_named_binary(
+		std::span<const std::byte> data, const Query &query, const ReadOptions &options = {});
+	std::vector<Tag> query_named_binary(
+		const std::filesystem::path &path, const Query &query, const ReadOptions &options = {});
+
+	class QueryError : public std::exception {
+	public:
+		explicit QueryError(std::string message) : message(std::move(message)) {}
+
+		const char *what() const noexcept override {
+			return message.c_str();
+		}
+
+	private:
+		const std::string message;
+	};
+
+}
@@ -0,0 +1,106 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "reader.hpp"
+
+#include <algorithm>
+
+namespace nbt {
+
+	Reader::Reader(std::span<const std::byte> data) : data(data) {}
+
+	Reader::Reader(Source *source) : source(source) {}
+
+	Reader::~Reader() {
+		// hand back whatever was read ahead so the source is left just past the tag, as if it were read byte by byte
+		if (source != nullptr)
+			source->put_back(data.size() - position);
+	}
+
+	// what every read of a primitive gets once the reader has failed
+	static constexpr std::byte ZEROS[8] = {};
+
+	const std::byte *Reader::take_slow(size_t length) {
+		if (!fill(length)) {
+			fail(ErrorCode::END_OF_INPUT);
+			return ZEROS;
+		}
+
+		const std::byte *result = data.data() + position;
+		position += length;
+		return result;
+	}
+
+	// Makes at least length bytes available from position, which is moved to the start of the buffer. The buffer only
+	// grows as the source delivers, doubling each time it is full, so a bogus length runs out of input long before it
+	// runs out of memory.
+	bool Reader::fill(size_t length) {
+		if (source == nullptr || failed())
+			return false;
+
+		const size_t unread = data.size() - position;
+		if (unread != 0)
+			std::memmove(buffer.data(), data.data() + position, unread);
+
+		if (buffer.size() < BLOCK_SIZE)
+			buffer.resize(BLOCK_SIZE);
+		base += position;
+		position = 0;
+
+		size_t available = unread;
+		while (available < length) {
+			if (available == buffer.size())
+				buffer.resize(std::min(length, buffer.size() * 2));
+
+			const size_t count = source->read(buffer.data() + available, buffer.size() - available);
+			if (count == 0) {
+				data = {buffer.data(), available};
+				return false;
+			}
+
+			available += count;
+		}
+
+		data = {buffer.data(), available};
+		return true;
+	}
+
+	void Reader::skip_slow(size_t length) {
+		length -= data.size() - position;
+		position = data.size();
+
+		// skipped in blocks so that jumping over a huge array never grows the buffer
+		while (length != 0) {
+			const size_t step = std::min(length, BLOCK_SIZE);
+			if (!fill(step)) {
+				fail(ErrorCode::END_OF_INPUT);
+				return;
+			}
+
+			position += step;
+			length -= step;
+		}
+	}
+
+}
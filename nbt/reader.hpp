@@ -0,0 +1,176 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "io.hpp"
+#include "source.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace nbt {
+
+	// Decodes big-endian primitives from a cursor over a contiguous block of bytes.
+	// When constructed from a source, input is pulled in large blocks so that only a refill makes a virtual call.
+	// Nothing here throws on bad input (a source may, on a failure of its own): the first error is kept, and every read
+	// after it returns zeros, so a decoder need only check failed() once per item rather than unwind from each read.
+	class Reader {
+	public:
+		explicit Reader(std::span<const std::byte> data);
+		explicit Reader(Source *source);
+		~Reader();
+
+		Reader(const Reader &) = delete;
+		Reader &operator=(const Reader &) = delete;
+
+		int8_t read_byte() {
+			return static_cast<int8_t>(*take(1));
+		}
+
+		int16_t read_short() {
+			return load_big_endian<int16_t>(take(2));
+		}
+
+		int32_t read_int() {
+			return load_big_endian<int32_t>(take(4));
+		}
+
+		int64_t read_long() {
+			return load_big_endian<int64_t>(take(8));
+		}
+
+		float read_float() {
+			const int32_t src = read_int();
+			float dst;
+			static_assert(sizeof(src) == sizeof(dst));
+			memcpy(&dst, &src, sizeof(src));
+			return dst;
+		}
+
+		double read_double() {
+			const int64_t src = read_long();
+			double dst;
+			static_assert(sizeof(src) == sizeof(dst));
+			memcpy(&dst, &src, sizeof(src));
+			return dst;
+		}
+
+		// the returned span is only valid until the next read, and empty once the reader has failed
+		std::span<const std::byte> read_bytes(size_t length) {
+			if (data.size() - position < length && !fill(length)) [[unlikely]] {
+				fail(ErrorCode::END_OF_INPUT);
+				return {};
+			}
+
+			const std::span<const std::byte> result = data.subspan(position, length);
+			position += length;
+			return result;
+		}
+
+		void skip(size_t length) {
+			if (data.size() - position >= length)
+				position += length;
+			else
+				skip_slow(length);
+		}
+
+		// Records error unless an earlier one was, and cuts the input off where the reader stands.
+		void fail(ErrorCode error) {
+			if (failed())
+				return;
+
+			code = error;
+			error_offset = consumed();
+			data = data.first(position);
+		}
+
+		bool failed() const {
+			return code != ErrorCode::NONE;
+		}
+
+		ErrorCode error() const {
+			return code;
+		}
+
+		// how many bytes had been consumed when the error was recorded
+		size_t error_position() const {
+			return error_offset;
+		}
+
+		size_t consumed() const {
+			return base + position;
+		}
+
+		// Both are only meaningful for a reader over a span, as a source's buffer moves on every refill.
+		std::span<const std::byte> input() const {
+			return data;
+		}
+
+		size_t offset() const {
+			return position;
+		}
+
+		// whether input() is the whole input rather than a window onto a source
+		bool contiguous() const {
+			return source == nullptr;
+		}
+
+	private:
+		static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+		template <typename T> static T load_big_endian(const std::byte *bytes) {
+			std::make_unsigned_t<T> result = 0;
+			for (size_t i = 0; i < sizeof(T); ++i)
+				result = (result << 8) | std::to_integer<uint8_t>(bytes[i]);
+
+			return static_cast<T>(result);
+		}
+
+		// for primitives, which are at most 8 bytes
+		const std::byte *take(size_t length) {
+			if (data.size() - position < length) [[unlikely]]
+				return take_slow(length);
+
+			const std::byte *result = data.data() + position;
+			position += length;
+			return result;
+		}
+
+		const std::byte *take_slow(size_t length);
+		bool fill(size_t length);
+		void skip_slow(size_t length);
+
+		Source *source = nullptr;
+		std::vector<std::byte> buffer;
+		std::span<const std::byte> data;
+		size_t position = 0;
+		size_t base = 0; // bytes consumed before data
+		ErrorCode code = ErrorCode::NONE;
+		size_t error_offset = 0;
+	};
+
+}
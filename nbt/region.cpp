@@ -0,0 +1,204 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "region.hpp"
+#include "parallel.hpp"
+
+#include <charconv>
+#include <string>
+#include <string_view>
+
+namespace nbt {
+
+	enum : uint8_t {
+		COMPRESSION_GZIP = 1,
+		COMPRESSION_ZLIB = 2,
+		COMPRESSION_NONE = 3,
+	};
+
+	// the whole of text as a number
+	static std::optional<int> parse_int(std::string_view text) {
+		int result = 0;
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+		if (error != std::errc() || end != text.data() + text.size())
+			return {};
+
+		return result;
+	}
+
+	static std::optional<std::pair<int, int>> parse_position(const std::filesystem::path &path) {
+		const std::string name = path.filename().string();
+		const std::string_view rest = name;
+		if (!rest.starts_with("r.") || !rest.ends_with(".mca"))
+			return {};
+
+		const std::string_view coordinates = rest.substr(2, rest.size() - 6);
+		const size_t dot = coordinates.find('.');
+		if (dot == std::string_view::npos)
+			return {};
+
+		const std::optional<int> x = parse_int(coordinates.substr(0, dot));
+		const std::optional<int> z = parse_int(coordinates.substr(dot + 1));
+		if (!x.has_value() || !z.has_value())
+			return {};
+
+		return std::make_pair(x.value(), z.value());
+	}
+
+	Region::Region(const std::filesystem::path &path)
+		: path(path), file(std::make_shared<const MappedFile>(path)), position(parse_position(path)) {
+		// the game leaves empty region files behind, which hold no chunks rather than being broken
+		const size_t size = file->data().size();
+		if (size != 0 && size < 2 * SECTOR_SIZE)
+			throw IOError("Truncated region header");
+	}
+
+	bool Region::has_chunk(int x, int z) const {
+		return header_entry(0, x, z) != 0;
+	}
+
+	uint32_t Region::timestamp(int x, int z) const {
+		return header_entry(1, x, z);
+	}
+
+	std::optional<NamedTag> Region::read_chunk(int x, int z, const ReadOptions &options) const {
+		ReadStatus status;
+		std::optional<NamedTag> chunk = try_read_chunk(x, z, status, options);
+		if (!status.ok())
+			throw IOError(status.message);
+
+		return chunk;
+	}
+
+	// a failure of the region itself rather than of the chunk's tag, reported the way a broken input is
+	static ReadStatus bad_chunk(int x, int z, const std::string &problem) {
+		return {ErrorCode::BAD_INPUT, 0, "Chunk " + std::to_string(x) + ", " + std::to_string(z) + " " + problem};
+	}
+
+	std::optional<NamedTag> Region::try_read_chunk(int x, int z, ReadStatus &status, const ReadOptions &options) const {
+		status = {};
+		const uint32_t location = header_entry(0, x, z);
+		if (location == 0)
+			return {};
+
+		const std::span<const std::byte> data = file->data();
+		const size_t offset = static_cast<size_t>(location >> 8) * SECTOR_SIZE;
+		const size_t sectors = location & 0xFF;
+
+		if (offset < 2 * SECTOR_SIZE || offset + 5 > data.size()) {
+			status = bad_chunk(x, z, "lies outside the region");
+			return {};
+		}
+
+		const std::span<const std::byte> header = data.subspan(offset, 5);
+		const uint32_t length = (std::to_integer<uint32_t>(header[0]) << 24) |
+								(std::to_integer<uint32_t>(header[1]) << 16) |
+								(std::to_integer<uint32_t>(header[2]) << 8) | std::to_integer<uint32_t>(header[3]);
+		const uint8_t compression = std::to_integer<uint8_t>(header[4]);
+
+		if ((compression & EXTERNAL_FLAG) != 0) {
+			if (!position.has_value()) {
+				status = {ErrorCode::BAD_INPUT, 0, "External chunks need a region file named r.<x>.<z>.mca"};
+				return {};
+			}
+
+			const int chunk_x = position->first * SIZE + (x & (SIZE - 1));
+			const int chunk_z = position->second * SIZE + (z & (SIZE - 1));
+			const std::string name = "c." + std::to_string(chunk_x) + "." + std::to_string(chunk_z) + ".mcc";
+			return try_read_named_binary(path.parent_path() / name, status, options);
+		}
+
+		if (length == 0 || length - 1 > data.size() - offset - 5 || length + 4 > sectors * SECTOR_SIZE) {
+			status = bad_chunk(x, z, "has an invalid length");
+			return {};
+		}
+
+		switch (compression) {
+			case COMPRESSION_GZIP:
+			case COMPRESSION_ZLIB:
+			case COMPRESSION_NONE: {
+				// Strings are never borrowed from the mapping, which the chunk does not keep alive once the region
+				// is gone; the stream header tells these apart just as well as the type byte does.
+				ReadOptions copying = options;
+				copying.borrow_strings = false;
+				return try_read_named_binary(data.subspan(offset + 5, length - 1), file, status, copying);
+			}
+			default:
+				status = {ErrorCode::BAD_INPUT, 0, "Unsupported chunk compression: " + std::to_string(compression)};
+				return {};
+		}
+	}
+
+	void Region::for_each_chunk(const std::function<void(int x, int z, NamedTag &chunk)> &visit, int threads,
+		const ReadOptions &options, const ChunkError &error) const {
+		// one table for every chunk, which each thread reads through a cache of its own, so that only names new to a
+		// thread take its lock
+		KeyTable keys;
+		const ReadOptions shared = with_keys(options, keys);
+
+		// chunks are independent compressed blobs, so each one is simply a separate task
+		parallel_for(SIZE * SIZE, threads, [&](size_t index) {
+			const int x = static_cast<int>(index % SIZE);
+			const int z = static_cast<int>(index / SIZE);
+
+			ReadStatus status;
+			std::optional<NamedTag> chunk = try_read_chunk(x, z, status, shared);
+			if (chunk.has_value())
+				visit(x, z, chunk.value());
+			else if (!status.ok() && error)
+				error(x, z, status);
+		});
+	}
+
+	std::vector<std::optional<NamedTag>> Region::read_all_chunks(
+		int threads, const ReadOptions &options, const ChunkError &error) const {
+		// the chunks outlive the call, so unless options name a table each keeps keys of its own
+		std::vector<std::optional<NamedTag>> result(SIZE * SIZE);
+
+		parallel_for(SIZE * SIZE, threads, [&](size_t index) {
+			const int x = static_cast<int>(index % SIZE);
+			const int z = static_cast<int>(index / SIZE);
+
+			ReadStatus status;
+			result[index] = try_read_chunk(x, z, status, options);
+			if (!status.ok() && error)
+				error(x, z, status);
+		});
+
+		return result;
+	}
+
+	uint32_t Region::header_entry(size_t table, int x, int z) const {
+		const std::span<const std::byte> data = file->data();
+		if (data.empty())
+			return 0;
+
+		const size_t index = (x & (SIZE - 1)) + (z & (SIZE - 1)) * SIZE;
+		const std::span<const std::byte> entry = data.subspan(table * SECTOR_SIZE + index * 4, 4);
+
+		return (std::to_integer<uint32_t>(entry[0]) << 24) | (std::to_integer<uint32_t>(entry[1]) << 16) |
+			   (std::to_integer<uint32_t>(entry[2]) << 8) | std::to_integer<uint32_t>(entry[3]);
+	}
+
+}
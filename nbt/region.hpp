@@ -0,0 +1,83 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "io.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace nbt {
+
+	// Anvil region file (.mca) holding up to 32x32 chunks, each an independently compressed named tag.
+	// The file is mapped rather than read, so decoding one chunk only touches the pages holding that chunk.
+	class Region {
+	public:
+		static constexpr int SIZE = 32;
+		static constexpr size_t SECTOR_SIZE = 4096;
+
+		explicit Region(const std::filesystem::path &path);
+
+		// Chunk coordinates may be given relative to the region or to the world; only the lowest five bits are used.
+		bool has_chunk(int x, int z) const;
+		// last modification of the chunk in seconds since the epoch, or 0 if it is absent
+		uint32_t timestamp(int x, int z) const;
+		// nullopt if the chunk is absent
+		std::optional<NamedTag> read_chunk(int x, int z, const ReadOptions &options = {}) const;
+		// Counterpart of read_chunk for regions that may be damaged: nullopt with status ok if the chunk is absent,
+		// and nullopt with the failure in status if it cannot be read.
+		std::optional<NamedTag> try_read_chunk(int x, int z, ReadStatus &status, const ReadOptions &options = {}) const;
+
+		// Called for a chunk that is present but cannot be read; the rest of the region is read regardless.
+		using ChunkError = std::function<void(int x, int z, const ReadStatus &status)>;
+
+		// Decode every present chunk across up to threads threads (one per core if not positive), handing each to
+		// visit on the thread that decoded it as soon as it is done. Chunks that cannot be read go to error, if given,
+		// and are otherwise passed over. Unless options name a key table, the chunks share one that goes when this
+		// returns, so a chunk kept past that has to be copied rather than moved out.
+		void for_each_chunk(const std::function<void(int x, int z, NamedTag &chunk)> &visit, int threads = 0,
+			const ReadOptions &options = {}, const ChunkError &error = {}) const;
+		// Decode every chunk in parallel, collected in header order (x + z * SIZE), with nullopt for absent ones and
+		// for those that cannot be read, which also go to error if it is given.
+		std::vector<std::optional<NamedTag>> read_all_chunks(
+			int threads = 0, const ReadOptions &options = {}, const ChunkError &error = {}) const;
+
+	private:
+		// storage type of a chunk, whose payload then lives in a separate .mcc file
+		static constexpr uint8_t EXTERNAL_FLAG = 0x80;
+
+		uint32_t header_entry(size_t table, int x, int z) const;
+
+		std::filesystem::path path;
+		std::shared_ptr<const MappedFile> file;
+		// parsed from the r.<x>.<z>.mca name, only needed to find external chunks
+		std::optional<std::pair<int, int>> position;
+	};
+
+}
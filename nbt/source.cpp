@@ -0,0 +1,65 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "source.hpp"
+#include "io.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace nbt {
+
+	size_t SpanSource::read(std::byte *result, size_t length) {
+		length = std::min(length, data.size() - position);
+		if (length == 0)
+			return 0;
+
+		memcpy(result, data.data() + position, length);
+		position += length;
+		return length;
+	}
+
+	void SpanSource::put_back(size_t length) {
+		position -= std::min(length, position);
+	}
+
+	size_t StreamSource::read(std::byte *result, size_t length) {
+		stream.read(reinterpret_cast<char *>(result), static_cast<std::streamsize>(length));
+		if (stream.bad())
+			throw IOError("Read error");
+
+		return static_cast<size_t>(stream.gcount());
+	}
+
+	// only streams that can seek get their bytes back
+	void StreamSource::put_back(size_t length) {
+		if (length == 0)
+			return;
+
+		stream.clear();
+		if (!stream.seekg(-static_cast<std::streamoff>(length), std::ios::cur))
+			stream.clear();
+	}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <span>
+
+namespace nbt {
+
+	// Stream of bytes that a Reader pulls blocks from.
+	class Source {
+	public:
+		virtual ~Source() = default;
+
+		// Read up to length bytes into data, returning how many were read; 0 means the input has ended.
+		virtual size_t read(std::byte *data, size_t length) = 0;
+
+		// Hand back the last length bytes read, where the input allows it, so that read-ahead is not lost.
+		virtual void put_back(size_t /*length*/) {}
+	};
+
+	class SpanSource : public Source {
+	public:
+		explicit SpanSource(std::span<const std::byte> data) : data(data) {}
+
+		size_t read(std::byte *result, size_t length) override;
+		void put_back(size_t length) override;
+
+	private:
+		std::span<const std::byte> data;
+		size_t position = 0;
+	};
+
+	class StreamSource : public Source {
+	public:
+		explicit StreamSource(std::istream &stream) : stream(stream) {}
+
+		size_t read(std::byte *result, size_t length) override;
+		void put_back(size_t length) override;
+
+	private:
+		std::istream &stream;
+	};
+
+}
@@ -0,0 +1,425 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tag.hpp"
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace nbt {
+
+	Compound::Compound(std::pmr::memory_resource *memory) : entries(memory) {}
+
+	// the index is left behind, as copies are usually only walked or written out
+	Compound::Compound(const Compound &other) : entries(other.entries) {}
+
+	Compound::Compound(Compound &&other) noexcept = default;
+
+	Compound &Compound::operator=(const Compound &other) {
+		entries = other.entries;
+		index.reset();
+		return *this;
+	}
+
+	// positions survive even an element-wise move between resources, so the index stays valid
+	Compound &Compound::operator=(Compound &&other) = default;
+
+	Compound::~Compound() = default;
+
+	void Compound::push_back(NamedTag entry) {
+		entries.push_back(std::move(entry));
+
+		if (index != nullptr)
+			index->try_emplace(entries.back().name, entries.size() - 1);
+	}
+
+	Compound::iterator Compound::insert(const_iterator position, NamedTag entry) {
+		const auto at = static_cast<size_t>(position - entries.begin());
+		const iterator result = entries.insert(position, std::move(entry));
+
+		if (index != nullptr) {
+			for (auto &[name, i] : *index) {
+				if (i >= at)
+					++i;
+			}
+
+			// the index names each entry by a view of its own name, so an earlier namesake replaces it outright
+			const auto [existing, added] = index->try_emplace(result->name, at);
+			if (!added && at < existing->second) {
+				index->erase(existing);
+				index->try_emplace(result->name, at);
+			}
+		}
+
+		return result;
+	}
+
+	// the index holds views of the names, so it is brought up to date while the erased one is still there
+	Compound::iterator Compound::erase(const_iterator position) {
+		const auto at = static_cast<size_t>(position - entries.begin());
+
+		if (index != nullptr) {
+			const auto existing = index->find(position->name);
+			const bool was_first = existing != index->end() && existing->second == at;
+			if (was_first)
+				index->erase(existing);
+
+			for (auto &[name, i] : *index) {
+				if (i > at)
+					--i;
+			}
+
+			// a later entry of the same name, if the compound has duplicates, now comes first
+			if (was_first) {
+				for (size_t i = at + 1; i < entries.size(); ++i) {
+					if (entries[i].name == position->name) {
+						index->try_emplace(entries[i].name, i - 1);
+						break;
+					}
+				}
+			}
+		}
+
+		return entries.erase(position);
+	}
+
+	void Compound::pop_back() {
+		const size_t at = entries.size() - 1;
+		if (index != nullptr) {
+			// the index only names the last entry if it has no earlier namesake
+			const auto existing = index->find(entries[at].name);
+			if (existing != index->end() && existing->second == at)
+				index->erase(existing);
+		}
+
+		entries.pop_back();
+	}
+
+	void Compound::clear() {
+		entries.clear();
+		index.reset();
+	}
+
+	Tag *Compound::find(std::string_view name) {
+		if (index == nullptr && entries.size() >= INDEX_THRESHOLD)
+			build_index();
+
+		return const_cast<Tag *>(std::as_const(*this).find(name));
+	}
+
+	const Tag *Compound::find(std::string_view name) const {
+		const NamedTag *entry;
+		if (index == nullptr) {
+			entry = scan(name);
+		} else {
+			const auto existing = index->find(name);
+			entry = existing != index->end() ? &entries[existing->second] : nullptr;
+		}
+
+		return entry != nullptr ? &entry->tag : nullptr;
+	}
+
+	const NamedTag *Compound::scan(std::string_view name) const {
+		for (const NamedTag &entry : entries) {
+			if (entry.name.str() == name)
+				return &entry;
+		}
+
+		return nullptr;
+	}
+
+	void Compound::build_index() {
+		auto built = std::make_unique<Index>();
+		built->reserve(entries.size());
+
+		// try_emplace keeps the first of any duplicate names, as a scan would find
+		for (size_t i = 0; i < entries.size(); ++i)
+			built->try_emplace(entries[i].name, i);
+
+		index = std::move(built);
+	}
+
+	size_t Compound::KeyHash::operator()(std::string_view name) const {
+		return std::hash<std::string_view>()(name);
+	}
+
+	bool Compound::KeyEqual::operator()(std::string_view a, std::string_view b) const {
+		return a == b;
+	}
+
+	// A container boxed with the resource given, which should be the one it allocates from itself, so that unbox can
+	// find it again.
+	template <typename T, typename... Args> static T *box(std::pmr::memory_resource *memory, Args &&...args) {
+		std::pmr::polymorphic_allocator<T> allocator(memory);
+		T *result = allocator.allocate(1);
+
+		try {
+			std::construct_at(result, std::forward<Args>(args)...);
+		} catch (...) {
+			allocator.deallocate(result, 1);
+			throw;
+		}
+
+		return result;
+	}
+
+	template <typename T> static void unbox(T *value) {
+		std::pmr::polymorphic_allocator<T> allocator(value->get_allocator());
+		std::destroy_at(value);
+		allocator.deallocate(value, 1);
+	}
+
+	static void unbox(Compound *value) {
+		std::pmr::polymorphic_allocator<Compound> allocator(value->memory());
+		std::destroy_at(value);
+		allocator.deallocate(value, 1);
+	}
+
+	Tag Tag::of_byte_array(ByteArray value) {
+		Tag tag(TagType::BYTE_ARRAY);
+		tag.m_payload.byte_array = box<ByteArray>(value.get_allocator().resource(), std::move(value));
+		return tag;
+	}
+
+	Tag Tag::of_string(String value) {
+		Tag tag(TagType::STRING);
+		tag.m_payload.string = box<String>(value.get_allocator().resource(), std::move(value));
+		return tag;
+	}
+
+	Tag Tag::of_borrowed_string(std::string_view text, std::pmr::memory_resource *memory) {
+		if (text.size() > std::numeric_limits<uint16_t>::max())
+			return of_string(String(text, memory));
+
+		Tag tag(TagType::STRING);
+		tag.m_borrowed = true;
+		tag.m_length = static_cast<uint16_t>(text.size());
+		tag.m_payload.chars = text.data();
+		return tag;
+	}
+
+	Tag Tag::of_list(TagType content_type, List value) {
+		Tag tag(TagType::LIST, content_type);
+		tag.m_payload.list = box<List>(value.get_allocator().resource(), std::move(value));
+		return tag;
+	}
+
+	Tag Tag::of_compound(Compound value) {
+		Tag tag(TagType::COMPOUND);
+		tag.m_payload.compound = box<Compound>(value.memory(), std::move(value));
+		return tag;
+	}
+
+	Tag Tag::of_int_array(IntArray value) {
+		Tag tag(TagType::INT_ARRAY);
+		tag.m_payload.int_array = box<IntArray>(value.get_allocator().resource(), std::move(value));
+		return tag;
+	}
+
+	Tag Tag::of_long_array(LongArray value) {
+		Tag tag(TagType::LONG_ARRAY);
+		tag.m_payload.long_array = box<LongArray>(value.get_allocator().resource(), std::move(value));
+		return tag;
+	}
+
+	Tag Tag::of_deferred(TagType type, TagType content_type, Deferred value) {
+		Tag tag(type, content_type);
+		tag.m_deferred = true;
+		tag.m_payload.deferred = new Deferred(std::move(value));
+		return tag;
+	}
+
+	// Copies of containers and strings use the default resource, as copies of the containers themselves do, and copies
+	// of borrowed strings own their text.
+	Tag::Tag(const Tag &other) : m_type(other.m_type), m_content_type(other.m_content_type) {
+		std::pmr::memory_resource *memory = std::pmr::get_default_resource();
+
+		if (other.m_deferred) {
+			m_payload.deferred = new Deferred(*other.m_payload.deferred);
+			m_deferred = true;
+			return;
+		}
+
+		switch (m_type) {
+			case TagType::STRING:
+				m_payload.string = box<String>(memory, other.string_text(), memory);
+				break;
+			case TagType::LIST:
+				m_payload.list = box<List>(memory, *other.m_payload.list);
+				break;
+			case TagType::COMPOUND:
+				m_payload.compound = box<Compound>(memory, *other.m_payload.compound);
+				break;
+			case TagType::BYTE_ARRAY:
+				m_payload.byte_array = box<ByteArray>(memory, *other.m_payload.byte_array);
+				break;
+			case TagType::INT_ARRAY:
+				m_payload.int_array = box<IntArray>(memory, *other.m_payload.int_array);
+				break;
+			case TagType::LONG_ARRAY:
+				m_payload.long_array = box<LongArray>(memory, *other.m_payload.long_array);
+				break;
+			default:
+				m_payload = other.m_payload;
+				break;
+		}
+	}
+
+	Tag &Tag::operator=(const Tag &other) {
+		Tag copy(other);
+		swap(copy);
+		return *this;
+	}
+
+	// the old value goes with moved, so that it is torn down the same way as on destruction
+	Tag &Tag::operator=(Tag &&other) noexcept {
+		Tag moved(std::move(other));
+		swap(moved);
+		return *this;
+	}
+
+	void Tag::swap(Tag &other) noexcept {
+		std::swap(m_type, other.m_type);
+		std::swap(m_content_type, other.m_content_type);
+		std::swap(m_deferred, other.m_deferred);
+		std::swap(m_borrowed, other.m_borrowed);
+		std::swap(m_length, other.m_length);
+		std::swap(m_payload, other.m_payload);
+	}
+
+	void Tag::own_string() {
+		std::pmr::memory_resource *memory = std::pmr::get_default_resource();
+		String *owned = box<String>(memory, string_text(), memory);
+		m_borrowed = false;
+		m_length = 0;
+		m_payload.string = owned;
+	}
+
+	void Tag::release() noexcept {
+		if (m_deferred) {
+			delete m_payload.deferred;
+			return;
+		}
+
+		if (m_borrowed)
+			return;
+
+		switch (m_type) {
+			case TagType::STRING:
+				unbox(m_payload.string);
+				break;
+			case TagType::LIST:
+				unbox(m_payload.list);
+				break;
+			case TagType::COMPOUND:
+				unbox(m_payload.compound);
+				break;
+			case TagType::BYTE_ARRAY:
+				unbox(m_payload.byte_array);
+				break;
+			case TagType::INT_ARRAY:
+				unbox(m_payload.int_array);
+				break;
+			case TagType::LONG_ARRAY:
+				unbox(m_payload.long_array);
+				break;
+			default:
+				break;
+		}
+	}
+
+	void Tag::abandon() noexcept {
+		m_type = TagType::END;
+		m_deferred = false;
+		m_borrowed = false;
+	}
+
+	static bool has_children(const Tag &tag) {
+		if (tag.is_deferred())
+			return false;
+
+		return (tag.type() == TagType::LIST && !tag.list_value().empty()) ||
+			(tag.type() == TagType::COMPOUND && !tag.compound_value().empty());
+	}
+
+	static Tag &last_child(Tag &tag) {
+		if (tag.type() == TagType::LIST)
+			return tag.list_value().back();
+
+		Compound &entries = tag.compound_value();
+		return entries[entries.size() - 1].tag;
+	}
+
+	static void drop_last_child(Tag &tag) {
+		if (tag.type() == TagType::LIST)
+			tag.list_value().pop_back();
+		else
+			tag.compound_value().pop_back();
+	}
+
+	// Nested lists and compounds are emptied from the last child up, as leaving each to destroy the next would recurse
+	// as deep as the tree goes. A tag left to go into a child is remembered by putting it in that child's place, each
+	// one holding the next up the tree, so the way back needs neither the stack nor an allocation.
+	Tag::~Tag() {
+		if (has_children(*this)) {
+			Tag current(std::move(*this));
+			Tag pending;
+
+			while (true) {
+				if (has_children(current)) {
+					Tag &child = last_child(current);
+					if (!has_children(child)) {
+						drop_last_child(current);
+						continue;
+					}
+
+					Tag next(std::move(child));
+					child.swap(pending);
+					pending.swap(current);
+					current.swap(next);
+				} else if (pending.type() != TagType::END) {
+					// current goes where the tag above kept its place, and is dropped from there
+					current.swap(pending);
+					pending.swap(last_child(current));
+					drop_last_child(current);
+				} else {
+					break;
+				}
+			}
+		}
+
+		release();
+	}
+
+	Tag *Tag::find(std::string_view name) {
+		return compound_value().find(name);
+	}
+
+	const Tag *Tag::find(std::string_view name) const {
+		return compound_value().find(name);
+	}
+
+}
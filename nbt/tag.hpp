@@ -24,12 +24,16 @@
 
 #pragma once
 
-#include <QList>
-#include <QMap>
-#include <QString>
-#include <QVariant>
+#include "key.hpp"
 #include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
 // Very ugly definitions for NBT tags
 // Even though this is not machine generated you might as well consider it as such if it makes you feel better :)
@@ -42,9 +46,13 @@ namespace nbt {
 	using Long = int64_t;
 	using Float = float;
 	using Double = double;
-	using String = QString;
-	using List = QList<class Tag>;
-	using Compound = QList<class NamedTag>;
+	using String = std::pmr::string; // UTF-8
+	// containers take a memory resource so that a whole document can be decoded into one arena
+	using List = std::pmr::vector<class Tag>;
+	struct NamedTag;
+	using ByteArray = std::pmr::vector<Byte>;
+	using IntArray = std::pmr::vector<Int>;
+	using LongArray = std::pmr::vector<Long>;
 
 	enum class TagType : Byte {
 		END = 0,
@@ -64,152 +72,407 @@ namespace nbt {
 
 	constexpr Byte TAG_ID_COUNT = static_cast<Byte>(TagType::LONG_ARRAY) + 1;
 
+	// Entries of a compound tag in the order they were read, which is the order they are written back in. Compounds
+	// past INDEX_THRESHOLD entries also get a hash index from name to position, built by the first lookup and kept up
+	// to date by every change after that.
+	class Compound {
+	public:
+		using value_type = NamedTag;
+		using iterator = std::pmr::vector<NamedTag>::iterator;
+		using const_iterator = std::pmr::vector<NamedTag>::const_iterator;
+
+		// below this a scan is cheaper than hashing the name
+		static constexpr size_t INDEX_THRESHOLD = 16;
+
+		Compound() = default;
+		explicit Compound(std::pmr::memory_resource *memory);
+		Compound(const Compound &other);
+		Compound(Compound &&other) noexcept;
+		Compound &operator=(const Compound &other);
+		Compound &operator=(Compound &&other);
+		~Compound();
+
+		size_t size() const;
+		bool empty() const;
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		NamedTag &operator[](size_t position);
+		const NamedTag &operator[](size_t position) const;
+
+		void reserve(size_t capacity);
+		void push_back(NamedTag entry);
+		iterator insert(const_iterator position, NamedTag entry);
+		iterator erase(const_iterator position);
+		void pop_back();
+		void clear();
+
+		// The value of the first entry with the given name, or null. The const overload only uses an index built
+		// earlier, so that concurrent lookups never write to the compound. Only the value is handed out, and any
+		// non-const access to the entries drops the index, since a name may be changed through it; the next find that
+		// wants an index builds it again.
+		Tag *find(std::string_view name);
+		const Tag *find(std::string_view name) const;
+
+		// where the entries are allocated from
+		std::pmr::memory_resource *memory() const;
+
+	private:
+		struct KeyHash {
+			using is_transparent = void;
+			size_t operator()(std::string_view name) const;
+		};
+
+		struct KeyEqual {
+			using is_transparent = void;
+			bool operator()(std::string_view a, std::string_view b) const;
+		};
+
+		// views of the entries' names, whose text stays put however the entries move
+		using Index = std::unordered_map<std::string_view, size_t, KeyHash, KeyEqual>;
+
+		std::pmr::vector<NamedTag> entries;
+		std::unique_ptr<Index> index;
+
+		const NamedTag *scan(std::string_view name) const;
+		void build_index();
+	};
+
+	// Compound or list payload left undecoded by a lazy read until nbt::materialize is called on its tag.
+	struct Deferred {
+		std::shared_ptr<const void> owner; // keeps the payload bytes alive, if they are not the caller's
+		std::span<const std::byte> payload;
+		int32_t length; // number of entries or items
+		int depth;
+	};
+
+	// A tag is two words whatever it holds: scalars sit in the tag itself, while strings, arrays, lists, compounds and
+	// deferred payloads live out of line behind a pointer. Containers are boxed with the memory resource they allocate
+	// from, strings included, so a tree decoded into an arena has nothing on the heap. Asking for the wrong kind of
+	// value throws std::bad_variant_access.
+	//
+	// A string can also be borrowed: a view of text owned by something else, such as the input a Document was read
+	// from. string_text() reads it as it is, while the mutable string_value() and copying the tag make an owned string
+	// of it first.
 	class Tag {
 	public:
 		static Tag of_byte(Byte value = 0) {
-			return {TagType::BYTE, value};
+			Tag tag(TagType::BYTE);
+			tag.m_payload.as_byte = value;
+			return tag;
 		}
 
 		static Tag of_short(Short value = 0) {
-			return {TagType::SHORT, value};
+			Tag tag(TagType::SHORT);
+			tag.m_payload.as_short = value;
+			return tag;
 		}
 
 		static Tag of_int(Int value = 0) {
-			return {TagType::INT, value};
+			Tag tag(TagType::INT);
+			tag.m_payload.as_int = value;
+			return tag;
 		}
 
 		static Tag of_long(Long value = 0) {
-			return {TagType::LONG, value};
+			Tag tag(TagType::LONG);
+			tag.m_payload.as_long = value;
+			return tag;
 		}
 
 		static Tag of_float(Float value = 0) {
-			return {TagType::FLOAT, value};
+			Tag tag(TagType::FLOAT);
+			tag.m_payload.as_float = value;
+			return tag;
 		}
 
 		static Tag of_double(Double value = 0) {
-			return {TagType::DOUBLE, value};
-		}
+			Tag tag(TagType::DOUBLE);
+			tag.m_payload.as_double = value;
+			return tag;
+		}
+
+		static Tag of_byte_array(ByteArray value = {});
+		static Tag of_string(String value = {});
+		// text must outlive the tag; anything past 65535 bytes is copied into memory instead
+		static Tag of_borrowed_string(
+			std::string_view text, std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+		static Tag of_list(TagType content_type, List value = {});
+		static Tag of_compound(Compound value = {});
+		static Tag of_int_array(IntArray value = {});
+		static Tag of_long_array(LongArray value = {});
+		static Tag of_deferred(TagType type, TagType content_type, Deferred value);
 
-		static Tag of_byte_array(List value = {}) {
-			return {TagType::BYTE_ARRAY, std::move(value)};
-		}
+		Tag() = default;
+		Tag(const Tag &other);
 
-		static Tag of_string(String value = "") {
-			return {TagType::STRING, std::move(value)};
+		// the moved-from tag is left an END tag
+		Tag(Tag &&other) noexcept
+			: m_type(other.m_type), m_content_type(other.m_content_type), m_deferred(other.m_deferred),
+			  m_borrowed(other.m_borrowed), m_length(other.m_length), m_payload(other.m_payload) {
+			other.m_type = TagType::END;
+			other.m_content_type = TagType::END;
+			other.m_deferred = false;
+			other.m_borrowed = false;
 		}
 
-		static Tag of_list(TagType content_type, List value = {}) {
-			return {TagType::LIST, content_type, std::move(value)};
-		}
+		Tag &operator=(const Tag &other);
+		Tag &operator=(Tag &&other) noexcept;
+		~Tag();
 
-		static Tag of_compound(Compound value = {}) {
-			return {TagType::COMPOUND, std::move(value)};
+		TagType type() const {
+			return m_type;
 		}
 
-		static Tag of_int_array(List value = {}) {
-			return {TagType::INT_ARRAY, std::move(value)};
+		TagType content_type() const {
+			return m_content_type;
 		}
 
-		static Tag of_long_array(List value = {}) {
-			return {TagType::LONG_ARRAY, std::move(value)};
+		bool is_deferred() const {
+			return m_deferred;
 		}
 
-		Tag() = default;
-
-		TagType type() const {
-			return m_type;
+		bool is_borrowed() const {
+			return m_borrowed;
 		}
 
-		TagType content_type() const {
-			return m_content_type;
+		const Deferred &deferred_value() const {
+			if (!m_deferred)
+				throw std::bad_variant_access();
+
+			return *m_payload.deferred;
 		}
 
 		Byte &byte_value() {
-			return std::get<Byte>(value);
+			expect(TagType::BYTE);
+			return m_payload.as_byte;
 		}
 
 		Short &short_value() {
-			return std::get<Short>(value);
+			expect(TagType::SHORT);
+			return m_payload.as_short;
 		}
 
 		Int &int_value() {
-			return std::get<Int>(value);
+			expect(TagType::INT);
+			return m_payload.as_int;
 		}
 
 		Long &long_value() {
-			return std::get<Long>(value);
+			expect(TagType::LONG);
+			return m_payload.as_long;
 		}
 
 		Float &float_value() {
-			return std::get<Float>(value);
+			expect(TagType::FLOAT);
+			return m_payload.as_float;
 		}
 
 		Double &double_value() {
-			return std::get<Double>(value);
+			expect(TagType::DOUBLE);
+			return m_payload.as_double;
 		}
 
 		String &string_value() {
-			return std::get<String>(value);
+			if (m_borrowed)
+				own_string();
+
+			expect(TagType::STRING);
+			return *m_payload.string;
 		}
 
 		List &list_value() {
-			return std::get<List>(value);
+			expect(TagType::LIST);
+			return *m_payload.list;
 		}
 
 		Compound &compound_value() {
-			return std::get<Compound>(value);
+			expect(TagType::COMPOUND);
+			return *m_payload.compound;
+		}
+
+		ByteArray &byte_array_value() {
+			expect(TagType::BYTE_ARRAY);
+			return *m_payload.byte_array;
+		}
+
+		IntArray &int_array_value() {
+			expect(TagType::INT_ARRAY);
+			return *m_payload.int_array;
+		}
+
+		LongArray &long_array_value() {
+			expect(TagType::LONG_ARRAY);
+			return *m_payload.long_array;
 		}
 
 		const Byte &byte_value() const {
-			return std::get<Byte>(value);
+			expect(TagType::BYTE);
+			return m_payload.as_byte;
 		}
 
 		const Short &short_value() const {
-			return std::get<Short>(value);
+			expect(TagType::SHORT);
+			return m_payload.as_short;
 		}
 
 		const Int &int_value() const {
-			return std::get<Int>(value);
+			expect(TagType::INT);
+			return m_payload.as_int;
 		}
 
 		const Long &long_value() const {
-			return std::get<Long>(value);
+			expect(TagType::LONG);
+			return m_payload.as_long;
 		}
 
 		const Float &float_value() const {
-			return std::get<Float>(value);
+			expect(TagType::FLOAT);
+			return m_payload.as_float;
 		}
 
 		const Double &double_value() const {
-			return std::get<Double>(value);
+			expect(TagType::DOUBLE);
+			return m_payload.as_double;
 		}
 
+		// Throws std::bad_variant_access for a borrowed string, which has no String to refer to; string_text() reads
+		// both kinds.
 		const String &string_value() const {
-			return std::get<String>(value);
+			expect(TagType::STRING);
+			return *m_payload.string;
+		}
+
+		// the text of a string tag, borrowed or not
+		std::string_view string_text() const {
+			if (m_type != TagType::STRING)
+				throw std::bad_variant_access();
+
+			return m_borrowed ? std::string_view(m_payload.chars, m_length) : std::string_view(*m_payload.string);
 		}
 
 		const List &list_value() const {
-			return std::get<List>(value);
+			expect(TagType::LIST);
+			return *m_payload.list;
 		}
 
 		const Compound &compound_value() const {
-			return std::get<Compound>(value);
+			expect(TagType::COMPOUND);
+			return *m_payload.compound;
 		}
 
+		const ByteArray &byte_array_value() const {
+			expect(TagType::BYTE_ARRAY);
+			return *m_payload.byte_array;
+		}
+
+		const IntArray &int_array_value() const {
+			expect(TagType::INT_ARRAY);
+			return *m_payload.int_array;
+		}
+
+		const LongArray &long_array_value() const {
+			expect(TagType::LONG_ARRAY);
+			return *m_payload.long_array;
+		}
+
+		// Entry of a decoded compound tag by name, or null if it has none.
+		Tag *find(std::string_view name);
+		const Tag *find(std::string_view name) const;
+
 	private:
+		friend class Document;
+
+		// which member is live follows from m_type, m_deferred and m_borrowed
+		union Payload {
+			Long as_long = 0; // first, so that a new tag's payload is all zero
+			Byte as_byte;
+			Short as_short;
+			Int as_int;
+			Float as_float;
+			Double as_double;
+			String *string;
+			const char *chars; // of a borrowed string, m_length long
+			List *list;
+			Compound *compound;
+			ByteArray *byte_array;
+			IntArray *int_array;
+			LongArray *long_array;
+			Deferred *deferred;
+		};
+
 		TagType m_type = TagType::END;
 		TagType m_content_type = TagType::END;
-		std::variant<std::monostate, Byte, Short, Int, Long, Float, Double, String, List, Compound> value;
+		bool m_deferred = false;
+		bool m_borrowed = false;
+		uint16_t m_length = 0; // fits beside the flags, where a std::string_view would not
+		Payload m_payload;
+
+		explicit Tag(TagType type, TagType content_type = TagType::END) : m_type(type), m_content_type(content_type) {}
 
-		Tag(TagType type, decltype(value) value) : m_type(type), value(std::move(value)) {}
+		void expect(TagType type) const {
+			if (m_type != type || m_deferred || m_borrowed)
+				throw std::bad_variant_access();
+		}
 
-		Tag(TagType type, TagType content_type, decltype(value) value)
-			: m_type(type), m_content_type(content_type), value(std::move(value)) {}
+		void swap(Tag &other) noexcept;
+		// turns a borrowed string into one the tag owns
+		void own_string();
+		// frees the payload, if it is out of line, leaving the tag to be overwritten or destroyed
+		void release() noexcept;
+		// Lets go of the payload without freeing anything, for a tree that lives entirely in an arena about to go.
+		void abandon() noexcept;
 	};
 
+	static_assert(sizeof(Tag) <= 16);
+
 	struct NamedTag {
 		Tag tag;
-		QString name;
+		Key name;
 	};
 
+	inline size_t Compound::size() const {
+		return entries.size();
+	}
+
+	inline bool Compound::empty() const {
+		return entries.empty();
+	}
+
+	inline Compound::iterator Compound::begin() {
+		index.reset();
+		return entries.begin();
+	}
+
+	inline Compound::iterator Compound::end() {
+		index.reset();
+		return entries.end();
+	}
+
+	inline Compound::const_iterator Compound::begin() const {
+		return entries.begin();
+	}
+
+	inline Compound::const_iterator Compound::end() const {
+		return entries.end();
+	}
+
+	inline NamedTag &Compound::operator[](size_t position) {
+		index.reset();
+		return entries[position];
+	}
+
+	inline const NamedTag &Compound::operator[](size_t position) const {
+		return entries[position];
+	}
+
+	inline void Compound::reserve(size_t capacity) {
+		entries.reserve(capacity);
+	}
+
+	inline std::pmr::memory_resource *Compound::memory() const {
+		return entries.get_allocator().resource();
+	}
+
 }
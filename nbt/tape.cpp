@@ -0,0 +1,464 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tape.hpp"
+#include "byteswap.hpp"
+#include "inflate.hpp"
+#include "mapped_file.hpp"
+#include "mutf8.hpp"
+#include "reader.hpp"
+#include "walker.hpp"
+
+#include <bit>
+#include <new>
+#include <variant>
+
+namespace nbt {
+
+	static constexpr int LENGTH_BITS = 16;
+
+	static uint64_t type_word(TagType type, uint64_t payload) {
+		return (static_cast<uint64_t>(type) << TAPE_TYPE_SHIFT) | payload;
+	}
+
+	// where a string or name is in the input, which strings are at most 65535 bytes long
+	static uint64_t text_word(size_t offset, uint16_t length) {
+		return (static_cast<uint64_t>(offset) << LENGTH_BITS) | length;
+	}
+
+	static std::string_view text_at(const std::byte *input, uint64_t word) {
+		const auto offset = static_cast<size_t>(word >> LENGTH_BITS);
+		const auto length = static_cast<size_t>(word & 0xFFFF);
+		return {reinterpret_cast<const char *>(input + offset), length};
+	}
+
+	// words a tag of this type takes when it is not a list or compound
+	static size_t width(TagType type) {
+		switch (type) {
+			case TagType::LONG:
+			case TagType::DOUBLE:
+			case TagType::BYTE_ARRAY:
+			case TagType::INT_ARRAY:
+			case TagType::LONG_ARRAY:
+				return 2;
+			default:
+				return 1;
+		}
+	}
+
+	// words a tape has room for before it first grows
+	static constexpr size_t TAPE_RESERVE = 256;
+
+	// Lays a named tag out on a tape in one pass, keeping a stack of its own rather than recursing.
+	class TapeBuilder {
+	public:
+		TapeBuilder(Reader &reader, int max_depth) : reader(reader), max_depth(max_depth) {
+			// how many words the input takes depends on how much of it is arrays, which take two whatever their
+			// length, so the tape starts small and grows rather than guessing from the size of the input
+			tape.words.reserve(TAPE_RESERVE);
+		}
+
+		// the tape, if the input was read without an error
+		std::optional<Tape> run(std::span<const std::byte> input, std::shared_ptr<const void> owner) {
+			const TagType type = read_tag_type(reader);
+			if (type == TagType::END) {
+				tape.words.push_back(text_word(0, 0));
+				tape.words.push_back(type_word(TagType::END, 0));
+			} else {
+				add_name();
+				add(type);
+			}
+
+			while (!stack.empty() && !reader.failed()) {
+				Frame &top = stack.back();
+				TagType item_type;
+
+				if (top.compound) {
+					item_type = read_tag_type(reader);
+					if (item_type == TagType::END) {
+						close();
+						continue;
+					}
+
+					++top.count;
+					add_name();
+				} else {
+					// the items of a list of END tags have nothing to read, so there is nothing to put down for them
+					if (top.remaining-- == 0 || top.item_type == TagType::END) {
+						close();
+						continue;
+					}
+
+					item_type = top.item_type;
+				}
+
+				add(item_type);
+			}
+
+			if (reader.failed())
+				return {};
+
+			// the tape lives as long as the document, so the room growing left at the end is given back
+			tape.words.shrink_to_fit();
+			tape.input = input;
+			tape.owner = std::move(owner);
+			return std::move(tape);
+		}
+
+	private:
+		// A list or compound whose end has yet to be reached.
+		struct Frame {
+			size_t header; // index of its first word
+			bool compound;
+			TagType item_type; // for lists
+			int32_t remaining; // for lists
+			uint32_t count; // entries so far, for compounds
+		};
+
+		Reader &reader;
+		const int max_depth;
+		Tape tape;
+		std::vector<Frame> stack;
+
+		void add_name() {
+			tape.words.push_back(text());
+		}
+
+		// where the name or string the reader stands at is in the input, which the read checks
+		uint64_t text() {
+			const std::string_view value = read_text(reader);
+			return text_word(reader.offset() - value.size(), static_cast<uint16_t>(value.size()));
+		}
+
+		void add(TagType type) {
+			std::vector<uint64_t> &words = tape.words;
+
+			switch (type) {
+				case TagType::END:
+					words.push_back(type_word(type, 0));
+					return;
+				case TagType::BYTE:
+					words.push_back(type_word(type, static_cast<uint8_t>(reader.read_byte())));
+					return;
+				case TagType::SHORT:
+					words.push_back(type_word(type, static_cast<uint16_t>(reader.read_short())));
+					return;
+				case TagType::INT:
+				case TagType::FLOAT:
+					words.push_back(type_word(type, static_cast<uint32_t>(reader.read_int())));
+					return;
+				case TagType::LONG:
+				case TagType::DOUBLE:
+					words.push_back(type_word(type, 0));
+					words.push_back(static_cast<uint64_t>(reader.read_long()));
+					return;
+				case TagType::STRING:
+					words.push_back(type_word(type, text()));
+					return;
+				case TagType::BYTE_ARRAY:
+				case TagType::INT_ARRAY:
+				case TagType::LONG_ARRAY: {
+					const int32_t length = reader.read_int();
+					if (length < 0) {
+						reader.fail(ErrorCode::NEGATIVE_LENGTH);
+						return;
+					}
+
+					const size_t element = type == TagType::BYTE_ARRAY ? 1 : type == TagType::INT_ARRAY ? 4 : 8;
+					words.push_back(type_word(type, reader.offset()));
+					words.push_back(static_cast<uint64_t>(length));
+					reader.skip(static_cast<size_t>(length) * element);
+					return;
+				}
+				case TagType::LIST:
+				case TagType::COMPOUND:
+					open(type);
+					return;
+			}
+		}
+
+		void open(TagType type) {
+			if (static_cast<int>(stack.size()) > max_depth) {
+				reader.fail(ErrorCode::MAX_DEPTH_REACHED);
+				return;
+			}
+
+			Frame frame = {tape.words.size(), type == TagType::COMPOUND, TagType::END, 0, 0};
+			uint64_t second = 0;
+
+			if (type == TagType::LIST) {
+				frame.item_type = read_tag_type(reader);
+				frame.remaining = read_list_length(reader, frame.item_type);
+				if (reader.failed())
+					return;
+
+				second = type_word(frame.item_type, static_cast<uint32_t>(frame.remaining));
+			}
+
+			tape.words.push_back(type_word(type, 0));
+			tape.words.push_back(second);
+			stack.push_back(frame);
+		}
+
+		// fills in where the list or compound on top ends, now that it has
+		void close() {
+			const Frame &top = stack.back();
+			tape.words[top.header] |= tape.words.size();
+			if (top.compound)
+				tape.words[top.header + 1] = top.count;
+
+			stack.pop_back();
+		}
+	};
+
+	std::optional<Tape> try_read_named_tape(
+		std::span<const std::byte> data, ReadStatus &status, const ReadOptions &options) {
+		return try_read_named_tape(data, nullptr, status, options);
+	}
+
+	std::optional<Tape> try_read_named_tape(std::span<const std::byte> data, std::shared_ptr<const void> owner,
+		ReadStatus &status, const ReadOptions &options) {
+		// strings and arrays are read out of the input later, so compressed input is inflated up front and kept
+		if (const Compression compression = detect_compression(data); compression != Compression::NONE) {
+			try {
+				SpanSource input(data);
+				auto inflated = std::make_shared<const std::vector<std::byte>>(inflate_all(input, compression));
+				data = *inflated;
+				owner = std::move(inflated);
+			} catch (const IOError &error) {
+				status = {ErrorCode::BAD_INPUT, 0, error.what()};
+				return {};
+			} catch (const std::bad_alloc &) {
+				status = {ErrorCode::BAD_INPUT, 0, "Out of memory"};
+				return {};
+			}
+		}
+
+		Reader reader(data);
+		std::optional<Tape> result = TapeBuilder(reader, options.max_depth).run(data, std::move(owner));
+
+		if (reader.failed()) {
+			status = {reader.error(), reader.error_position(), describe(reader.error())};
+			return {};
+		}
+
+		status = {};
+		return result;
+	}
+
+	std::optional<Tape> try_read_named_tape(
+		const std::filesystem::path &path, ReadStatus &status, const ReadOptions &options) {
+		std::shared_ptr<const MappedFile> file;
+		try {
+			file = std::make_shared<const MappedFile>(path);
+		} catch (const IOError &error) {
+			status = {ErrorCode::BAD_INPUT, 0, error.what()};
+			return {};
+		}
+
+		return try_read_named_tape(file->data(), file, status, options);
+	}
+
+	Tape read_named_tape(std::span<const std::byte> data, const ReadOptions &options) {
+		return read_named_tape(data, nullptr, options);
+	}
+
+	Tape read_named_tape(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, const ReadOptions &options) {
+		ReadStatus status;
+		std::optional<Tape> result = try_read_named_tape(data, std::move(owner), status, options);
+		if (!result.has_value())
+			throw IOError(status.message);
+
+		return std::move(result.value());
+	}
+
+	Tape read_named_tape(const std::filesystem::path &path, const ReadOptions &options) {
+		ReadStatus status;
+		std::optional<Tape> result = try_read_named_tape(path, status, options);
+		if (!result.has_value())
+			throw IOError(status.message);
+
+		return std::move(result.value());
+	}
+
+	void TapeCursor::expect(TagType type) const {
+		if (this->type() != type)
+			throw std::bad_variant_access();
+	}
+
+	size_t TapeCursor::after() const {
+		const TagType type = this->type();
+		if (is_container(type))
+			return static_cast<size_t>(payload());
+
+		return index + width(type);
+	}
+
+	TagType TapeCursor::content_type() const {
+		if (type() != TagType::LIST)
+			return TagType::END;
+
+		return static_cast<TagType>(words[index + 1] >> TAPE_TYPE_SHIFT);
+	}
+
+	size_t TapeCursor::size() const {
+		switch (type()) {
+			case TagType::LIST:
+				return static_cast<size_t>(words[index + 1] & 0xFFFFFFFF);
+			case TagType::COMPOUND:
+			case TagType::BYTE_ARRAY:
+			case TagType::INT_ARRAY:
+			case TagType::LONG_ARRAY:
+				return static_cast<size_t>(words[index + 1]);
+			default:
+				throw std::bad_variant_access();
+		}
+	}
+
+	std::string_view TapeCursor::raw_name() const {
+		return entry ? text_at(input, words[index - 1]) : std::string_view();
+	}
+
+	std::string TapeCursor::name() const {
+		return from_mutf8(raw_name());
+	}
+
+	Byte TapeCursor::byte_value() const {
+		expect(TagType::BYTE);
+		return static_cast<Byte>(payload());
+	}
+
+	Short TapeCursor::short_value() const {
+		expect(TagType::SHORT);
+		return static_cast<Short>(payload());
+	}
+
+	Int TapeCursor::int_value() const {
+		expect(TagType::INT);
+		return static_cast<Int>(payload());
+	}
+
+	Long TapeCursor::long_value() const {
+		expect(TagType::LONG);
+		return static_cast<Long>(words[index + 1]);
+	}
+
+	Float TapeCursor::float_value() const {
+		expect(TagType::FLOAT);
+		return std::bit_cast<Float>(static_cast<uint32_t>(payload()));
+	}
+
+	Double TapeCursor::double_value() const {
+		expect(TagType::DOUBLE);
+		return std::bit_cast<Double>(words[index + 1]);
+	}
+
+	std::string_view TapeCursor::raw_string() const {
+		expect(TagType::STRING);
+		return text_at(input, payload());
+	}
+
+	std::string TapeCursor::string_value() const {
+		return from_mutf8(raw_string());
+	}
+
+	template <typename Array> static Array load_array(const std::byte *input, uint64_t offset, uint64_t count) {
+		Array result(static_cast<size_t>(count));
+		load_big_endian_array(result.data(), input + offset, result.size());
+		return result;
+	}
+
+	ByteArray TapeCursor::byte_array_value() const {
+		expect(TagType::BYTE_ARRAY);
+		return load_array<ByteArray>(input, payload(), words[index + 1]);
+	}
+
+	IntArray TapeCursor::int_array_value() const {
+		expect(TagType::INT_ARRAY);
+		return load_array<IntArray>(input, payload(), words[index + 1]);
+	}
+
+	LongArray TapeCursor::long_array_value() const {
+		expect(TagType::LONG_ARRAY);
+		return load_array<LongArray>(input, payload(), words[index + 1]);
+	}
+
+	TapeCursor TapeCursor::first_child() const {
+		const TagType type = this->type();
+		if (!is_container(type))
+			throw std::bad_variant_access();
+
+		// the header is two words, and an entry's name comes before its value
+		const size_t first = index + 2;
+		const size_t last = after();
+		if (first == last)
+			return {};
+
+		if (type == TagType::COMPOUND)
+			return {words, input, first + 1, last, true};
+
+		return {words, input, first, last, false};
+	}
+
+	TapeCursor TapeCursor::next_sibling() const {
+		const size_t next = after();
+		if (next >= end)
+			return {};
+
+		return {words, input, entry ? next + 1 : next, end, entry};
+	}
+
+	TapeCursor TapeCursor::at(size_t position) const {
+		if (position >= size())
+			return {};
+
+		const TagType item_type = content_type();
+		if (type() == TagType::LIST && !is_container(item_type)) {
+			const size_t first = index + 2;
+			const size_t last = after();
+			const size_t at = first + position * width(item_type);
+			return at < last ? TapeCursor(words, input, at, last, false) : TapeCursor();
+		}
+
+		TapeCursor result = first_child();
+		for (size_t i = 0; i < position && result.valid(); ++i)
+			result = result.next_sibling();
+
+		return result;
+	}
+
+	TapeCursor TapeCursor::find_field(std::string_view name) const {
+		expect(TagType::COMPOUND);
+		const std::string encoded = to_mutf8(name);
+
+		for (TapeCursor entry = first_child(); entry.valid(); entry = entry.next_sibling()) {
+			if (entry.raw_name() == encoded)
+				return entry;
+		}
+
+		return {};
+	}
+
+}
@@ -0,0 +1,162 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "io.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nbt {
+
+	// the top byte of a tag's first word on a tape is its type, and the rest its payload; see Tape
+	constexpr int TAPE_TYPE_SHIFT = 56;
+	constexpr uint64_t TAPE_PAYLOAD_MASK = (uint64_t(1) << TAPE_TYPE_SHIFT) - 1;
+
+	// A position on a Tape: a tag, and for a compound entry its name too. Moving to the next sibling jumps straight
+	// over a whole list or compound, however big. A cursor stays valid for as long as its tape, moves included. Asking
+	// for the wrong kind of value throws std::bad_variant_access; a cursor that points nowhere is not valid().
+	class TapeCursor {
+	public:
+		TapeCursor() = default;
+
+		bool valid() const {
+			return words != nullptr;
+		}
+
+		explicit operator bool() const {
+			return valid();
+		}
+
+		TagType type() const {
+			return static_cast<TagType>(words[index] >> TAPE_TYPE_SHIFT);
+		}
+
+		// item type of a list, END for anything else
+		TagType content_type() const;
+
+		// number of entries, items or elements in a compound, list or array
+		size_t size() const;
+
+		// the name of a compound entry or the root, as stored in Modified UTF-8, and converted to UTF-8
+		std::string_view raw_name() const;
+		std::string name() const;
+
+		Byte byte_value() const;
+		Short short_value() const;
+		Int int_value() const;
+		Long long_value() const;
+		Float float_value() const;
+		Double double_value() const;
+		// the string as stored in Modified UTF-8, pointing into the input, and converted to UTF-8
+		std::string_view raw_string() const;
+		std::string string_value() const;
+		ByteArray byte_array_value() const;
+		IntArray int_array_value() const;
+		LongArray long_array_value() const;
+
+		// First entry of a compound or item of a list, and the tag after this one in the same compound or list. The
+		// items of a list of END tags take no space on the tape and cannot be reached.
+		TapeCursor first_child() const;
+		TapeCursor next_sibling() const;
+		// Item of a list or entry of a compound by position. Items of lists of anything but lists and compounds are
+		// all the same width, so reaching one is a single step; otherwise it is one jump per sibling before it.
+		TapeCursor at(size_t position) const;
+		// The first entry of a compound with the given name, comparing encoded names without converting them.
+		TapeCursor find_field(std::string_view name) const;
+
+	private:
+		friend class Tape;
+
+		TapeCursor(const uint64_t *words, const std::byte *input, size_t index, size_t end, bool entry)
+			: words(words), input(input), index(index), end(end), entry(entry) {}
+
+		const uint64_t *words = nullptr;
+		const std::byte *input = nullptr;
+		size_t index = 0; // of the tag's first word
+		size_t end = 0; // one past the last word of whatever holds the tag
+		bool entry = false; // whether the word before the tag is its name
+
+		uint64_t payload() const {
+			return words[index] & TAPE_PAYLOAD_MASK;
+		}
+
+		// index of the first word after the tag and everything in it
+		size_t after() const;
+		void expect(TagType type) const;
+	};
+
+	// A read-only named tag laid out flat as 64-bit words, in one pass over the input and without building a tree.
+	// Every tag takes one word, or two for longs, doubles, arrays, lists and compounds. The top byte of a tag's first
+	// word is its type, and the rest holds:
+	//   - BYTE, SHORT, INT and FLOAT: the value's bits
+	//   - STRING: the input offset of its bytes, shifted left 16, then its length
+	//   - arrays: the input offset of the elements, whose count is the second word
+	//   - LIST and COMPOUND: the index of the word after the list or compound ends. The second word is the item count,
+	//     with the item type in its top byte, or the entry count.
+	// LONG and DOUBLE values are the second word. Each compound entry is preceded by a name word, encoded like a
+	// string without the type. The root's name word comes first on the tape.
+	// Strings and arrays are read out of the input on demand, so a tape keeps its input alive.
+	class Tape {
+	public:
+		TapeCursor root() const {
+			return {words.data(), input.data(), 1, words.size(), true};
+		}
+
+		// number of words on the tape
+		size_t size() const {
+			return words.size();
+		}
+
+	private:
+		friend class TapeBuilder;
+
+		Tape() = default;
+
+		std::vector<uint64_t> words;
+		std::span<const std::byte> input; // decompressed
+		std::shared_ptr<const void> owner; // keeps input alive, if the caller does not
+	};
+
+	// Builds a tape for the named tag encoded in data. gzip and zlib input is inflated first and the tape keeps the
+	// result; otherwise data must outlive the tape, unless owner keeps it alive. Only ReadOptions::max_depth applies.
+	std::optional<Tape> try_read_named_tape(
+		std::span<const std::byte> data, ReadStatus &status, const ReadOptions &options = {});
+	std::optional<Tape> try_read_named_tape(std::span<const std::byte> data, std::shared_ptr<const void> owner,
+		ReadStatus &status, const ReadOptions &options = {});
+	// maps the file at path, which the tape keeps mapped
+	std::optional<Tape> try_read_named_tape(
+		const std::filesystem::path &path, ReadStatus &status, const ReadOptions &options = {});
+	Tape read_named_tape(std::span<const std::byte> data, const ReadOptions &options = {});
+	Tape read_named_tape(
+		std::span<const std::byte> data, std::shared_ptr<const void> owner, const ReadOptions &options = {});
+	Tape read_named_tape(const std::filesystem::path &path, const ReadOptions &options = {});
+
+}
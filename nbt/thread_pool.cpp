@@ -0,0 +1,153 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "thread_pool.hpp"
+#include "parallel.hpp"
+
+namespace nbt {
+
+	// which pool and queue the current thread works for, so nested submissions stay local
+	static thread_local const ThreadPool *current_pool = nullptr;
+	static thread_local size_t current_queue = 0;
+
+	ThreadPool::ThreadPool(int threads) {
+		if (threads <= 0)
+			threads = default_thread_count();
+
+		for (int i = 0; i < threads; ++i)
+			queues.push_back(std::make_unique<Queue>());
+
+		for (int i = 0; i < threads; ++i)
+			workers.emplace_back([this, i] { run(i); });
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			const std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	void ThreadPool::submit(std::function<void()> task) {
+		const size_t index = current_pool == this ? current_queue : next_queue++ % queues.size();
+
+		pending.fetch_add(1);
+		{
+			const std::lock_guard lock(queues[index]->mutex);
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		queued.fetch_add(1);
+
+		// taking the lock orders this against a worker checking queued before it sleeps
+		{
+			const std::lock_guard lock(mutex);
+		}
+		wake.notify_one();
+	}
+
+	void ThreadPool::wait() {
+		std::unique_lock lock(mutex);
+		idle.wait(lock, [this] { return pending.load() == 0; });
+
+		if (error != nullptr) {
+			std::exception_ptr result = error;
+			error = nullptr;
+			failed = false;
+			std::rethrow_exception(result);
+		}
+	}
+
+	void ThreadPool::run(size_t index) {
+		current_pool = this;
+		current_queue = index;
+
+		while (true) {
+			std::function<void()> task;
+			if (!pop(index, task)) {
+				std::unique_lock lock(mutex);
+				wake.wait(lock, [this] { return stopping || queued.load() != 0; });
+				if (stopping && queued.load() == 0)
+					return;
+
+				continue;
+			}
+
+			if (!failed.load(std::memory_order_relaxed)) {
+				try {
+					task();
+				} catch (...) {
+					const std::lock_guard lock(mutex);
+					if (error == nullptr)
+						error = std::current_exception();
+					failed = true;
+				}
+			}
+
+			// the task may hold resources (such as a decoded chunk) that should go before anyone is told it is done
+			task = nullptr;
+			finish_task();
+		}
+	}
+
+	bool ThreadPool::pop(size_t index, std::function<void()> &task) {
+		{
+			Queue &own = *queues[index];
+			const std::lock_guard lock(own.mutex);
+			if (!own.tasks.empty()) {
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+
+		for (size_t offset = 1; offset < queues.size(); ++offset) {
+			Queue &victim = *queues[(index + offset) % queues.size()];
+			const std::lock_guard lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void ThreadPool::finish_task() {
+		if (pending.fetch_sub(1) != 1)
+			return;
+
+		{
+			const std::lock_guard lock(mutex);
+		}
+		idle.notify_all();
+	}
+
+}
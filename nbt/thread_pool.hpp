@@ -0,0 +1,82 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nbt {
+
+	// Work-stealing pool: each worker runs tasks from its own deque newest first, and an idle worker steals the
+	// oldest task of another. Tasks submitted from inside a task go to that worker's deque, so nested work stays
+	// local (and depth first) until some other worker runs dry.
+	class ThreadPool {
+	public:
+		// one worker per core if threads is not positive
+		explicit ThreadPool(int threads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		void submit(std::function<void()> task);
+
+		// Block until every submitted task, including those submitted by other tasks, has finished. The first
+		// exception thrown by a task makes the rest be dropped and is rethrown here. Must not be called from a task.
+		void wait();
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void run(size_t index);
+		bool pop(size_t index, std::function<void()> &task);
+		void finish_task();
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> next_queue = 0;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		std::atomic<size_t> queued = 0; // sitting in a deque
+		std::atomic<size_t> pending = 0; // submitted and not yet finished
+		bool stopping = false;
+		std::exception_ptr error;
+		std::atomic<bool> failed = false;
+	};
+
+}
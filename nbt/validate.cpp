@@ -0,0 +1,286 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "validate.hpp"
+#include "io.hpp"
+#include "walker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace nbt {
+
+	namespace {
+
+		struct Frame {
+			TagType type;
+			TagType item_type; // lists only
+			int32_t remaining; // lists only
+		};
+
+		class Scanner {
+		public:
+			explicit Scanner(std::span<const std::byte> data) : data(data) {}
+
+			ValidationResult run();
+
+		private:
+			bool need(size_t length) {
+				if (data.size() - position >= length)
+					return true;
+
+				return fail("EOF");
+			}
+
+			bool fail(const char *error) {
+				if (result.error == nullptr)
+					result.error = error;
+				return false;
+			}
+
+			uint8_t byte_at(size_t offset) const {
+				return std::to_integer<uint8_t>(data[offset]);
+			}
+
+			int32_t int_at(size_t offset) const {
+				return static_cast<int32_t>((uint32_t(byte_at(offset)) << 24) | (uint32_t(byte_at(offset + 1)) << 16) |
+											(uint32_t(byte_at(offset + 2)) << 8) | uint32_t(byte_at(offset + 3)));
+			}
+
+			bool tag_type(TagType &type);
+			bool string();
+			bool payload(TagType type);
+
+			std::span<const std::byte> data;
+			size_t position = 0;
+			// fixed size so deep input cannot make the scanner allocate
+			std::array<Frame, MAX_DEPTH + 1> stack;
+			int depth = 0;
+			ValidationResult result;
+		};
+
+	}
+
+	static bool valid_string_bytes(const uint8_t *bytes, size_t length);
+
+	ValidationResult validate(std::span<const std::byte> data) {
+		return Scanner(data).run();
+	}
+
+	ValidationResult Scanner::run() {
+		TagType type;
+		bool ok = tag_type(type);
+		if (ok && type != TagType::END)
+			ok = string() && payload(type);
+
+		while (ok && depth != 0) {
+			Frame &frame = stack[depth - 1];
+
+			if (frame.type == TagType::LIST) {
+				if (frame.remaining == 0) {
+					--depth;
+					continue;
+				}
+
+				--frame.remaining;
+				ok = payload(frame.item_type);
+				continue;
+			}
+
+			TagType item_type;
+			if (!tag_type(item_type))
+				break;
+
+			if (item_type == TagType::END) {
+				--depth;
+				continue;
+			}
+
+			ok = string() && payload(item_type);
+		}
+
+		result.valid = result.error == nullptr;
+		result.offset = position;
+		return result;
+	}
+
+	bool Scanner::tag_type(TagType &type) {
+		if (!need(1))
+			return false;
+
+		const uint8_t id = byte_at(position);
+		if (id >= TAG_ID_COUNT)
+			return fail("Invalid tag ID");
+
+		++position;
+		type = static_cast<TagType>(id);
+		return true;
+	}
+
+	bool Scanner::string() {
+		if (!need(2))
+			return false;
+
+		const size_t length = (size_t(byte_at(position)) << 8) | byte_at(position + 1);
+		position += 2;
+
+		if (!need(length))
+			return false;
+		if (!valid_string_bytes(reinterpret_cast<const uint8_t *>(data.data() + position), length))
+			return fail("Invalid string encoding");
+
+		position += length;
+		++result.string_count;
+		return true;
+	}
+
+	bool Scanner::payload(TagType type) {
+		++result.tag_count;
+
+		switch (type) {
+			case TagType::END:
+				return true;
+			case TagType::BYTE:
+				return need(1) && (position += 1, true);
+			case TagType::SHORT:
+				return need(2) && (position += 2, true);
+			case TagType::INT:
+			case TagType::FLOAT:
+				return need(4) && (position += 4, true);
+			case TagType::LONG:
+			case TagType::DOUBLE:
+				return need(8) && (position += 8, true);
+			case TagType::STRING:
+				return string();
+			case TagType::BYTE_ARRAY:
+			case TagType::INT_ARRAY:
+			case TagType::LONG_ARRAY: {
+				if (!need(4))
+					return false;
+
+				const int32_t length = int_at(position);
+				if (length < 0)
+					return fail("Negative array length");
+
+				position += 4;
+				const size_t width = type == TagType::BYTE_ARRAY ? 1 : type == TagType::INT_ARRAY ? 4 : 8;
+				if (!need(static_cast<size_t>(length) * width))
+					return false;
+
+				position += static_cast<size_t>(length) * width;
+				result.array_element_count += length;
+				return true;
+			}
+			case TagType::LIST:
+			case TagType::COMPOUND: {
+				if (depth > MAX_DEPTH)
+					return fail("Max depth reached");
+
+				Frame frame{type, TagType::END, 0};
+				if (type == TagType::LIST) {
+					if (!tag_type(frame.item_type) || !need(4))
+						return false;
+
+					frame.remaining = int_at(position);
+					if (frame.remaining < 0)
+						return fail("Negative list length");
+					// as when reading: END items carry no payload, so a few bytes could claim any number of them
+					if (frame.remaining > 0 && frame.item_type == TagType::END)
+						return fail("Invalid tag ID");
+
+					position += 4;
+					++result.list_count;
+
+					// items that are all the same size are bounds-checked and passed over in one step
+					if (const std::optional<size_t> size = fixed_size(frame.item_type); size.has_value()) {
+						const size_t bytes = static_cast<size_t>(frame.remaining) * size.value();
+						if (!need(bytes))
+							return false;
+
+						position += bytes;
+						result.tag_count += static_cast<size_t>(frame.remaining);
+						result.max_depth = std::max(result.max_depth, depth + 1);
+						return true;
+					}
+				} else {
+					++result.compound_count;
+				}
+
+				stack[depth++] = frame;
+				if (depth > result.max_depth)
+					result.max_depth = depth;
+				return true;
+			}
+		}
+
+		return fail("Unknown tag ID");
+	}
+
+	static bool is_continuation(uint8_t byte) {
+		return (byte & 0xC0) == 0x80;
+	}
+
+	static bool valid_string_bytes(const uint8_t *bytes, size_t length) {
+		size_t i = 0;
+		while (i < length) {
+			// almost every string is plain ASCII, which is checked eight bytes at a time
+			if (length - i >= 8) {
+				uint64_t block;
+				memcpy(&block, bytes + i, sizeof(block));
+				if ((block & 0x8080808080808080ULL) == 0) {
+					i += 8;
+					continue;
+				}
+			}
+
+			const uint8_t lead = bytes[i];
+			if (lead < 0x80) {
+				++i;
+			} else if (lead >= 0xC2 && lead <= 0xDF) {
+				if (length - i < 2 || !is_continuation(bytes[i + 1]))
+					return false;
+				i += 2;
+			} else if (lead == 0xC0) {
+				// Modified UTF-8 writes NUL as the overlong pair C0 80
+				if (length - i < 2 || bytes[i + 1] != 0x80)
+					return false;
+				i += 2;
+			} else if (lead >= 0xE0 && lead <= 0xEF) {
+				// surrogates (ED A0..BF) are allowed, as Modified UTF-8 encodes supplementary characters as pairs
+				if (length - i < 3 || !is_continuation(bytes[i + 1]) || !is_continuation(bytes[i + 2]))
+					return false;
+				if (lead == 0xE0 && bytes[i + 1] < 0xA0)
+					return false;
+				i += 3;
+			} else {
+				// including the leads of four-byte sequences, which Modified UTF-8 writes as surrogate pairs instead
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+}
@@ -0,0 +1,52 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace nbt {
+
+	struct ValidationResult {
+		bool valid = false;
+		// static description of the first problem found, null when valid
+		const char *error = nullptr;
+		// one past the end of the root tag when valid, otherwise where the problem was found
+		size_t offset = 0;
+
+		size_t tag_count = 0;
+		size_t compound_count = 0;
+		size_t list_count = 0;
+		size_t string_count = 0;
+		size_t array_element_count = 0;
+		int max_depth = 0;
+	};
+
+	// Walk a named root tag checking tag IDs, lengths, nesting depth and string encoding, without building a tree or
+	// allocating anything. Strings are accepted as UTF-8 or Java's Modified UTF-8.
+	ValidationResult validate(std::span<const std::byte> data);
+
+}
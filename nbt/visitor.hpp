@@ -0,0 +1,100 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "io.hpp"
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace nbt {
+
+	// What the decoder does next, returned by the callbacks that can open something.
+	enum class Visit : uint8_t {
+		ENTER,
+		// pass over it without decoding it
+		SKIP,
+		// end the walk here, successfully
+		STOP,
+	};
+
+	// Receives a tag as the decoder walks through it in file order, without a tree being built. Names and strings are
+	// handed over as the undecoded Modified UTF-8 bytes from the input, which nbt::from_mutf8 turns into UTF-8, and are
+	// only valid for the duration of the call. Every callback does nothing by default, so an implementation only
+	// overrides what it wants to see.
+	class Visitor {
+	public:
+		virtual ~Visitor() = default;
+
+		// Precedes the value of every named tag, the root's included. Skipping it drops the value without a word.
+		virtual Visit key(std::string_view /*name*/) {
+			return Visit::ENTER;
+		}
+
+		// Entering one is followed by its contents and then end(). Skipping a list or compound calls skipped() instead.
+		virtual Visit begin_compound() {
+			return Visit::ENTER;
+		}
+
+		virtual Visit begin_list(TagType /*item_type*/, int32_t /*length*/) {
+			return Visit::ENTER;
+		}
+
+		virtual Visit begin_array(TagType /*type*/, int32_t /*length*/) {
+			return Visit::ENTER;
+		}
+
+		// consecutive runs of an entered array's values, already in native byte order
+		virtual void array_chunk(std::span<const Byte> /*values*/) {}
+		virtual void array_chunk(std::span<const Int> /*values*/) {}
+		virtual void array_chunk(std::span<const Long> /*values*/) {}
+
+		virtual void end() {}
+
+		virtual void byte_value(Byte /*value*/) {}
+		virtual void short_value(Short /*value*/) {}
+		virtual void int_value(Int /*value*/) {}
+		virtual void long_value(Long /*value*/) {}
+		virtual void float_value(Float /*value*/) {}
+		virtual void double_value(Double /*value*/) {}
+		virtual void string_value(std::string_view /*value*/) {}
+
+		// A list or compound that was skipped. payload is its encoding if the input is in memory, otherwise empty;
+		// length counts its items or entries.
+		virtual void skipped(
+			TagType /*type*/, TagType /*content_type*/, std::span<const std::byte> /*payload*/, int32_t /*length*/) {}
+	};
+
+	// Walk visitor through a tag, decompressing as read_named_binary does. Only ReadOptions::max_depth applies. Bad
+	// input is reported as by the try_ functions; an exception thrown by the visitor goes straight through.
+	ReadStatus visit_named_binary(std::istream &input, Visitor &visitor, const ReadOptions &options = {});
+	ReadStatus visit_unnamed_binary(std::istream &input, Visitor &visitor, const ReadOptions &options = {});
+	ReadStatus visit_named_binary(std::span<const std::byte> data, Visitor &visitor, const ReadOptions &options = {});
+	ReadStatus visit_unnamed_binary(std::span<const std::byte> data, Visitor &visitor, const ReadOptions &options = {});
+	ReadStatus visit_named_binary(const std::filesystem::path &path, Visitor &visitor, const ReadOptions &options = {});
+	ReadStatus visit_unnamed_binary(
+		const std::filesystem::path &path, Visitor &visitor, const ReadOptions &options = {});
+
+}
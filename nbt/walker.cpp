@@ -0,0 +1,147 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "walker.hpp"
+
+namespace nbt {
+
+	// Like Walker, with a stack of its own whose first few dozen levels live in a local buffer, so that skipping does
+	// not allocate unless the input is nested very deeply.
+	void skip_payload(Reader &reader, TagType type, int depth, int max_depth) {
+		if (!is_container(type)) {
+			skip_value(reader, type);
+			return;
+		}
+
+		std::array<std::byte, 64 * sizeof(WalkFrame)> buffer;
+		std::pmr::monotonic_buffer_resource memory(buffer.data(), buffer.size());
+		std::pmr::vector<WalkFrame> stack(&memory);
+
+		const auto open = [&](TagType container, int at) {
+			if (at > max_depth) {
+				reader.fail(ErrorCode::MAX_DEPTH_REACHED);
+				return;
+			}
+
+			if (container == TagType::COMPOUND) {
+				stack.push_back({true, TagType::END, 0});
+				return;
+			}
+
+			const TagType item_type = read_tag_type(reader);
+			const int32_t length = read_list_length(reader, item_type);
+			if (reader.failed())
+				return;
+
+			// lists of numbers go in one step
+			if (const std::optional<size_t> size = fixed_size(item_type); size.has_value())
+				reader.skip(static_cast<size_t>(length) * size.value());
+			else
+				stack.push_back({false, item_type, length});
+		};
+
+		open(type, depth);
+
+		while (!stack.empty() && !reader.failed()) {
+			WalkFrame &top = stack.back();
+			TagType item_type;
+
+			if (top.compound) {
+				item_type = read_tag_type(reader);
+				if (item_type == TagType::END) {
+					stack.pop_back();
+					continue;
+				}
+
+				reader.skip(static_cast<uint16_t>(reader.read_short()));
+			} else {
+				if (top.remaining-- == 0) {
+					stack.pop_back();
+					continue;
+				}
+
+				item_type = top.item_type;
+			}
+
+			if (is_container(item_type))
+				open(item_type, depth + static_cast<int>(stack.size()));
+			else
+				skip_value(reader, item_type);
+		}
+	}
+
+	void skip_value(Reader &reader, TagType type) {
+		if (const std::optional<size_t> size = fixed_size(type); size.has_value()) {
+			reader.skip(size.value());
+			return;
+		}
+
+		switch (type) {
+			case TagType::STRING:
+				reader.skip(static_cast<uint16_t>(reader.read_short()));
+				return;
+			case TagType::BYTE_ARRAY:
+			case TagType::INT_ARRAY:
+			case TagType::LONG_ARRAY: {
+				const int32_t length = reader.read_int();
+				if (length < 0) {
+					reader.fail(ErrorCode::NEGATIVE_LENGTH);
+					return;
+				}
+
+				const size_t width = type == TagType::BYTE_ARRAY ? 1 : type == TagType::INT_ARRAY ? 4 : 8;
+				reader.skip(static_cast<size_t>(length) * width);
+				return;
+			}
+			default:
+				reader.fail(ErrorCode::INVALID_TAG_ID);
+				return;
+		}
+	}
+
+	void skip_items(Reader &reader, TagType item_type, int32_t length, int depth, int max_depth) {
+		if (const std::optional<size_t> size = fixed_size(item_type); size.has_value()) {
+			reader.skip(static_cast<size_t>(length) * size.value());
+			return;
+		}
+
+		for (int32_t i = 0; i < length && !reader.failed(); ++i)
+			skip_payload(reader, item_type, depth + 1, max_depth);
+	}
+
+	int32_t skip_entries(Reader &reader, int depth, int max_depth) {
+		int32_t count = 0;
+
+		// a failed reader only reads zeros, which end the compound
+		TagType item_type;
+		while ((item_type = read_tag_type(reader)) != TagType::END) {
+			reader.skip(static_cast<uint16_t>(reader.read_short()));
+			skip_payload(reader, item_type, depth + 1, max_depth);
+			++count;
+		}
+
+		return count;
+	}
+
+}
@@ -0,0 +1,355 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "byteswap.hpp"
+#include "mutf8.hpp"
+#include "reader.hpp"
+#include "visitor.hpp"
+#include <algorithm>
+#include <array>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace nbt {
+
+	inline bool is_container(TagType type) {
+		return type == TagType::LIST || type == TagType::COMPOUND;
+	}
+
+	// Payload size of the types whose payloads are always the same size.
+	inline std::optional<size_t> fixed_size(TagType type) {
+		switch (type) {
+			case TagType::END:
+				return 0;
+			case TagType::BYTE:
+				return 1;
+			case TagType::SHORT:
+				return 2;
+			case TagType::INT:
+			case TagType::FLOAT:
+				return 4;
+			case TagType::LONG:
+			case TagType::DOUBLE:
+				return 8;
+			default:
+				return {};
+		}
+	}
+
+	// END stands in for an invalid ID, so that whatever is reading stops
+	inline TagType read_tag_type(Reader &reader) {
+		const int8_t id = reader.read_byte();
+		if (id < 0 || id >= TAG_ID_COUNT) [[unlikely]] {
+			reader.fail(ErrorCode::INVALID_TAG_ID);
+			return TagType::END;
+		}
+
+		return static_cast<TagType>(id);
+	}
+
+	// The length of a list, read after its item type. Besides negative lengths, a list of END tags that claims to hold
+	// any is rejected, as the game does: they carry no payload, so a few bytes could stand for any number of tags.
+	inline int32_t read_list_length(Reader &reader, TagType item_type) {
+		const int32_t length = reader.read_int();
+		if (length < 0)
+			reader.fail(ErrorCode::NEGATIVE_LENGTH);
+		else if (length > 0 && item_type == TagType::END)
+			reader.fail(ErrorCode::INVALID_TAG_ID);
+
+		return length;
+	}
+
+	// The undecoded bytes of a name or string. One that could not be Modified UTF-8 fails the reader, as it would not
+	// come back out the same.
+	inline std::string_view read_text(Reader &reader) {
+		const uint16_t length = reader.read_short();
+		const std::span<const std::byte> bytes = reader.read_bytes(length);
+		const std::string_view text(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+		if (!may_be_mutf8(text)) [[unlikely]]
+			reader.fail(ErrorCode::INVALID_STRING);
+
+		return text;
+	}
+
+	// Moves past a payload without decoding it.
+	void skip_payload(Reader &reader, TagType type, int depth, int max_depth);
+	// Moves past anything but a list or compound.
+	void skip_value(Reader &reader, TagType type);
+	// Moves past the items of a list whose header has been read.
+	void skip_items(Reader &reader, TagType item_type, int32_t length, int depth, int max_depth);
+	// Moves past the entries of a compound, returning how many there were.
+	int32_t skip_entries(Reader &reader, int depth, int max_depth);
+
+	// A list or compound the walk is inside of.
+	struct WalkFrame {
+		bool compound;
+		TagType item_type; // for lists
+		int32_t remaining; // for lists
+	};
+
+	// Drives a handler with the callbacks of Visitor through encoded tags, keeping a stack of its own rather than
+	// recursing. A template so that the callbacks of a final handler such as the tree builder inline into the loop.
+	template <typename Handler> class Walker {
+	public:
+		Walker(Reader &reader, Handler &handler, int max_depth)
+			: reader(reader), handler(handler), max_depth(max_depth) {}
+
+		void named(int depth) {
+			const TagType type = read_tag_type(reader);
+			if (type == TagType::END)
+				return;
+
+			const std::string_view name = read_name();
+			if (reader.failed())
+				return;
+
+			switch (handler.key(name)) {
+				case Visit::ENTER:
+					payload(type, depth);
+					return;
+				case Visit::SKIP:
+					skip_payload(reader, type, depth, max_depth);
+					return;
+				case Visit::STOP:
+					return;
+			}
+		}
+
+		void unnamed(int depth) {
+			const TagType type = read_tag_type(reader);
+			if (!reader.failed())
+				payload(type, depth);
+		}
+
+		void payload(TagType type, int depth) {
+			if (!is_container(type)) {
+				value(type);
+				return;
+			}
+
+			// the first few dozen levels fit in here, so only very deep input makes the walk allocate
+			std::array<std::byte, 64 * sizeof(WalkFrame)> buffer;
+			std::pmr::monotonic_buffer_resource memory(buffer.data(), buffer.size());
+			std::pmr::vector<WalkFrame> stack(&memory);
+
+			open(stack, type, depth);
+
+			while (!stack.empty()) {
+				// the one check per item that stands in for unwinding from every read
+				if (reader.failed() || stopped) [[unlikely]]
+					return;
+
+				WalkFrame &top = stack.back();
+				TagType item_type;
+
+				if (top.compound) {
+					item_type = read_tag_type(reader);
+					if (item_type == TagType::END) {
+						stack.pop_back();
+						if (!reader.failed())
+							handler.end();
+						continue;
+					}
+
+					const std::string_view name = read_name();
+					if (reader.failed())
+						return;
+
+					const Visit visit = handler.key(name);
+					if (visit == Visit::STOP)
+						return;
+
+					if (visit == Visit::SKIP) {
+						skip_payload(reader, item_type, depth + static_cast<int>(stack.size()), max_depth);
+						continue;
+					}
+				} else {
+					if (top.remaining-- == 0) {
+						stack.pop_back();
+						handler.end();
+						continue;
+					}
+
+					item_type = top.item_type;
+				}
+
+				if (is_container(item_type))
+					open(stack, item_type, depth + static_cast<int>(stack.size()));
+				else
+					value(item_type);
+			}
+		}
+
+	private:
+		static constexpr size_t CHUNK_SIZE = 512;
+
+		std::string_view read_name() {
+			return read_text(reader);
+		}
+
+		// Reads the header of a list or compound and asks the handler whether to go in.
+		void open(std::pmr::vector<WalkFrame> &stack, TagType type, int depth) {
+			if (depth > max_depth) {
+				reader.fail(ErrorCode::MAX_DEPTH_REACHED);
+				return;
+			}
+
+			const size_t start = reader.offset();
+			TagType item_type = TagType::END;
+			int32_t length = 0;
+			Visit visit;
+
+			if (type == TagType::COMPOUND) {
+				visit = handler.begin_compound();
+			} else {
+				item_type = read_tag_type(reader);
+				length = read_list_length(reader, item_type);
+				if (reader.failed())
+					return;
+
+				visit = handler.begin_list(item_type, length);
+			}
+
+			if (visit == Visit::ENTER) {
+				// items of a list of nothing carry no payload, so there is nothing to go through
+				stack.push_back({type == TagType::COMPOUND, item_type, item_type == TagType::END ? 0 : length});
+				return;
+			}
+
+			if (visit == Visit::STOP) {
+				stopped = true;
+				return;
+			}
+
+			if (type == TagType::COMPOUND)
+				length = skip_entries(reader, depth, max_depth);
+			else
+				skip_items(reader, item_type, length, depth, max_depth);
+
+			if (reader.failed())
+				return;
+
+			std::span<const std::byte> payload;
+			if (reader.contiguous())
+				payload = reader.input().subspan(start, reader.offset() - start);
+
+			handler.skipped(type, item_type, payload, length);
+		}
+
+		// Decodes anything but a list or compound.
+		void value(TagType type) {
+			switch (type) {
+				case TagType::END:
+					// has no payload
+					return;
+				case TagType::BYTE:
+					report(reader.read_byte(), [&](Byte value) { handler.byte_value(value); });
+					return;
+				case TagType::SHORT:
+					report(reader.read_short(), [&](Short value) { handler.short_value(value); });
+					return;
+				case TagType::INT:
+					report(reader.read_int(), [&](Int value) { handler.int_value(value); });
+					return;
+				case TagType::LONG:
+					report(reader.read_long(), [&](Long value) { handler.long_value(value); });
+					return;
+				case TagType::FLOAT:
+					report(reader.read_float(), [&](Float value) { handler.float_value(value); });
+					return;
+				case TagType::DOUBLE:
+					report(reader.read_double(), [&](Double value) { handler.double_value(value); });
+					return;
+				case TagType::STRING:
+					report(read_name(), [&](std::string_view value) { handler.string_value(value); });
+					return;
+				case TagType::BYTE_ARRAY:
+					array<Byte>(type);
+					return;
+				case TagType::INT_ARRAY:
+					array<Int>(type);
+					return;
+				case TagType::LONG_ARRAY:
+					array<Long>(type);
+					return;
+				case TagType::LIST:
+				case TagType::COMPOUND:
+					break;
+			}
+
+			reader.fail(ErrorCode::INVALID_TAG_ID);
+		}
+
+		// handlers never see the zeros a failed reader makes up
+		template <typename T, typename Callback> void report(T value, Callback callback) {
+			if (!reader.failed()) [[likely]]
+				callback(value);
+		}
+
+		template <typename T> void array(TagType type) {
+			const int32_t length = reader.read_int();
+			if (length < 0)
+				reader.fail(ErrorCode::NEGATIVE_LENGTH);
+
+			// The whole payload is fetched first, so a bogus length fails on EOF before the handler allocates for it; a
+			// reader over a source grows its buffer only as far as the input actually goes.
+			const std::span<const std::byte> bytes = reader.read_bytes(static_cast<size_t>(length) * sizeof(T));
+			if (reader.failed())
+				return;
+
+			const Visit visit = handler.begin_array(type, length);
+			if (visit == Visit::STOP)
+				stopped = true;
+			if (visit != Visit::ENTER)
+				return;
+
+			// a handler that keeps the values has them loaded straight into its own storage, sized once, in one pass
+			if constexpr (requires { handler.template array_storage<T>(size_t()); }) {
+				load_big_endian_array(handler.template array_storage<T>(static_cast<size_t>(length)), bytes.data(),
+					static_cast<size_t>(length));
+			} else if constexpr (sizeof(T) == 1) {
+				handler.array_chunk(std::span<const T>(reinterpret_cast<const T *>(bytes.data()), bytes.size()));
+			} else {
+				std::array<T, CHUNK_SIZE> chunk;
+				for (size_t offset = 0; offset < static_cast<size_t>(length); offset += CHUNK_SIZE) {
+					const size_t count = std::min(CHUNK_SIZE, static_cast<size_t>(length) - offset);
+					load_big_endian_array(chunk.data(), bytes.data() + offset * sizeof(T), count);
+					handler.array_chunk(std::span<const T>(chunk.data(), count));
+				}
+			}
+
+			handler.end();
+		}
+
+		Reader &reader;
+		Handler &handler;
+		const int max_depth;
+		bool stopped = false;
+	};
+
+}
@@ -0,0 +1,112 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "world.hpp"
+#include "parallel.hpp"
+#include "region.hpp"
+#include "thread_pool.hpp"
+
+#include <memory>
+#include <semaphore>
+#include <string>
+
+namespace nbt {
+
+	// Held while a chunk is decoded and visited; released even if either throws, after the chunk itself is gone.
+	struct InFlightSlot {
+		explicit InFlightSlot(std::counting_semaphore<> &semaphore) : semaphore(semaphore) {
+			semaphore.acquire();
+		}
+
+		~InFlightSlot() {
+			semaphore.release();
+		}
+
+		std::counting_semaphore<> &semaphore;
+	};
+
+	void scan_world(const std::filesystem::path &directory, const ChunkVisitor &visit, const ScanOptions &options) {
+		const int threads = options.threads > 0 ? options.threads : default_thread_count();
+		const auto max_in_flight = static_cast<std::ptrdiff_t>(
+			options.max_in_flight != 0 ? options.max_in_flight : static_cast<size_t>(threads));
+
+		// one bad chunk in a whole world is to be expected, so it is passed on rather than ending the scan
+		const auto report = [&](const ChunkLocation &location, const ReadStatus &status) {
+			if (options.error)
+				options.error(location, status);
+		};
+
+		// Everything the tasks refer to comes before the pool, which runs whatever is still queued when it is
+		// destroyed, so that it outlives them even when walking the directory throws part way through.
+		std::counting_semaphore<> in_flight(max_in_flight);
+		ThreadPool pool(threads);
+
+		for (const std::filesystem::directory_entry &file : std::filesystem::recursive_directory_iterator(
+				 directory, std::filesystem::directory_options::skip_permission_denied)) {
+			const std::filesystem::path &path = file.path();
+			if (!file.is_regular_file() || path.extension() != ".mca")
+				continue;
+
+			const std::string kind = path.parent_path().filename().string();
+			if (kind != "region" && kind != "entities" && kind != "poi")
+				continue;
+
+			pool.submit([&, path, kind] {
+				std::shared_ptr<const Region> region;
+				try {
+					region = std::make_shared<const Region>(path);
+				} catch (const IOError &failure) {
+					report({path, kind, -1, -1}, {ErrorCode::BAD_INPUT, 0, failure.what()});
+					return;
+				}
+
+				// keys are shared by the chunks of a region only, so that the table goes with the region rather than
+				// collecting every name in the world; each worker looks them up through a cache of its own
+				const auto keys = std::make_shared<KeyTable>();
+				const auto read_options = std::make_shared<const ReadOptions>(with_keys(options.read_options, *keys));
+
+				for (int z = 0; z < Region::SIZE; ++z) {
+					for (int x = 0; x < Region::SIZE; ++x) {
+						if (!region->has_chunk(x, z))
+							continue;
+
+						pool.submit([&, region, keys, read_options, path, kind, x, z] {
+							const InFlightSlot slot(in_flight);
+
+							ReadStatus status;
+							std::optional<NamedTag> chunk = region->try_read_chunk(x, z, status, *read_options);
+							if (chunk.has_value())
+								visit({path, kind, x, z}, chunk.value());
+							else if (!status.ok())
+								report({path, kind, x, z}, status);
+						});
+					}
+				}
+			});
+		}
+
+		pool.wait();
+	}
+
+}
@@ -0,0 +1,65 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "io.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+namespace nbt {
+
+	struct ChunkLocation {
+		std::filesystem::path file; // region file the chunk was read from
+		std::string kind; // "region", "entities" or "poi", after the directory holding the file
+		int x; // relative to the region, or -1 for a failure of the whole file
+		int z;
+	};
+
+	// Called from the worker threads for a chunk, or a whole region file, that cannot be read.
+	using ScanError = std::function<void(const ChunkLocation &location, const ReadStatus &status)>;
+
+	struct ScanOptions {
+		// one per core if not positive
+		int threads = 0;
+		// Most chunks decoded and not yet released by the visitor at any one time, across every thread; one per
+		// thread if zero. Lower it to bound memory when chunks are large and visitors slow.
+		size_t max_in_flight = 0;
+		ReadOptions read_options;
+		// Where chunks and region files that cannot be read are reported; the scan carries on past them either way.
+		ScanError error;
+	};
+
+	using ChunkVisitor = std::function<void(const ChunkLocation &location, NamedTag &chunk)>;
+
+	// Decode every chunk under the region, entities and poi directories of a world (in any dimension) on a
+	// work-stealing pool, calling visit from the worker threads. Region files are spread over the workers, and the
+	// chunks of a region are stolen by idle workers, so a few large regions do not leave cores idle. Unless the read
+	// options name a key table, the chunks of a region share one that goes with the region, so a chunk kept past visit
+	// has to be copied rather than moved out.
+	void scan_world(const std::filesystem::path &directory, const ChunkVisitor &visit, const ScanOptions &options = {});
+
+}
@@ -0,0 +1,96 @@
+/*
+ * This project is licensed under the MIT license:
+ *
+ * Copyright (c) 2023-2024 TheKodeToad and project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "byteswap.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace nbt {
+
+	// Encodes big-endian primitives with plain stores into a buffer that was sized up front for the whole output, so
+	// no bounds are checked and nothing is allocated while encoding.
+	class Writer {
+	public:
+		explicit Writer(std::span<std::byte> output) : position(output.data()) {}
+
+		void write_byte(int8_t value) {
+			*position++ = static_cast<std::byte>(value);
+		}
+
+		void write_short(int16_t value) {
+			store_big_endian(value);
+		}
+
+		void write_int(int32_t value) {
+			store_big_endian(value);
+		}
+
+		void write_long(int64_t value) {
+			store_big_endian(value);
+		}
+
+		void write_float(float value) {
+			int32_t result;
+			static_assert(sizeof(value) == sizeof(result));
+			memcpy(&result, &value, sizeof(value));
+			write_int(result);
+		}
+
+		void write_double(double value) {
+			int64_t result;
+			static_assert(sizeof(value) == sizeof(result));
+			memcpy(&result, &value, sizeof(value));
+			write_long(result);
+		}
+
+		void write_bytes(std::span<const std::byte> value) {
+			if (value.empty())
+				return;
+
+			memcpy(position, value.data(), value.size());
+			position += value.size();
+		}
+
+		template <typename T> void write_array(const T *values, size_t count) {
+			store_big_endian_array(position, values, count);
+			position += count * sizeof(T);
+		}
+
+	private:
+		template <typename T> void store_big_endian(T value) {
+			const auto bits = static_cast<std::make_unsigned_t<T>>(value);
+			for (size_t i = 0; i < sizeof(T); ++i)
+				position[i] = static_cast<std::byte>(bits >> ((sizeof(T) - i - 1) * 8));
+
+			position += sizeof(T);
+		}
+
+		std::byte *position;
+	};
+
+}
@@ -23,6 +23,7 @@
  */
 
 #include "tag_model.hpp"
+#include "nbt/io.hpp"
 
 enum : int {
 	COLUMN_KEY,
@@ -34,10 +35,12 @@ struct TagModelNode {
 	TagModelNode *parent;
 	nbt::Tag *tag;
 	nbt::NamedTag *named_tag;
+	// elements of packed arrays have no tag of their own, so they are addressed by index into the parent
+	int array_index = -1;
 };
 
-template<typename T>
-static int index_of_ptr(const QList<T> &list, const T *item) {
+template<typename Container, typename T>
+static int index_of_ptr(const Container &list, const T *item) {
 	int index = 0;
 
 	for (const T &check_item : list) {
@@ -50,18 +53,48 @@ static int index_of_ptr(const QList<T> &list, const T *item) {
 	return -1;
 }
 
+// Answered from the header of deferred tags, so that showing a node never decodes it.
+static int child_count(const nbt::Tag &tag) {
+	if (tag.is_deferred())
+		return tag.deferred_value().length;
+
+	switch (tag.type()) {
+		case nbt::TagType::BYTE_ARRAY:
+			return static_cast<int>(tag.byte_array_value().size());
+		case nbt::TagType::INT_ARRAY:
+			return static_cast<int>(tag.int_array_value().size());
+		case nbt::TagType::LONG_ARRAY:
+			return static_cast<int>(tag.long_array_value().size());
+		case nbt::TagType::LIST:
+			return static_cast<int>(tag.list_value().size());
+		case nbt::TagType::COMPOUND:
+			return static_cast<int>(tag.compound_value().size());
+		default:
+			return 0;
+	}
+}
+
 TagModel::TagModel(std::shared_ptr<nbt::NamedTag> tag, QObject *parent)
-	: root_tag(std::move(tag)), root_node(std::make_unique<TagModelNode>(nullptr, &root_tag->tag, root_tag.get())), QAbstractItemModel(parent) {}
+	: root_tag(std::move(tag)), root_node(std::make_unique<TagModelNode>(nullptr, &root_tag->tag, root_tag.get())),
+	  QAbstractItemModel(parent) {}
 
 QModelIndex TagModel::index(int row, int column, const QModelIndex &parent) const {
 	TagModelNode *parent_node = node(parent);
 
-		switch (parent_node->tag->type()) {
+	if (parent_node->tag == nullptr)
+		return {};
+
+	// children are only decoded once the view first asks for one
+	nbt::materialize(*parent_node->tag);
+
+	switch (parent_node->tag->type()) {
 		case nbt::TagType::BYTE_ARRAY:
-		case nbt::TagType::LIST:
 		case nbt::TagType::INT_ARRAY:
 		case nbt::TagType::LONG_ARRAY:
-			return createIndex(row, column, new TagModelNode(parent_node, &parent_node->tag->list_value()[row], nullptr));
+			return createIndex(row, column, new TagModelNode(parent_node, nullptr, nullptr, row));
+		case nbt::TagType::LIST:
+			return createIndex(
+				row, column, new TagModelNode(parent_node, &parent_node->tag->list_value()[row], nullptr));
 		case nbt::TagType::COMPOUND: {
 			nbt::NamedTag &tag = parent_node->tag->compound_value()[row];
 			return createIndex(row, column, new TagModelNode(parent_node, &tag.tag, &tag));
@@ -74,17 +107,10 @@ QModelIndex TagModel::index(int row, int column, const QModelIndex &parent) cons
 int TagModel::rowCount(const QModelIndex &parent) const {
 	TagModelNode *parent_node = node(parent);
 
-	switch (parent_node->tag->type()) {
-		case nbt::TagType::BYTE_ARRAY:
-		case nbt::TagType::LIST:
-		case nbt::TagType::INT_ARRAY:
-		case nbt::TagType::LONG_ARRAY:
-			return parent_node->tag->list_value().length();
-		case nbt::TagType::COMPOUND:
-			return parent_node->tag->compound_value().length();
-		default:
-			return 0;
-	}
+	if (parent_node->tag == nullptr)
+		return 0;
+
+	return child_count(*parent_node->tag);
 }
 
 int TagModel::columnCount(const QModelIndex &parent) const {
@@ -100,10 +126,25 @@ QVariant TagModel::data(const QModelIndex &index, int role) const {
 	switch (index.column()) {
 		case COLUMN_KEY:
 			if (index_node->named_tag != nullptr)
-				return index_node->named_tag->name;
+				return QString::fromStdString(std::string(index_node->named_tag->name.str()));
 
 			return QString::number(index.row());
 		case COLUMN_VALUE:
+			if (index_node->tag == nullptr) {
+				const nbt::Tag *array = index_node->parent->tag;
+
+				switch (array->type()) {
+					case nbt::TagType::BYTE_ARRAY:
+						return QString::number(array->byte_array_value()[index_node->array_index]);
+					case nbt::TagType::INT_ARRAY:
+						return QString::number(array->int_array_value()[index_node->array_index]);
+					case nbt::TagType::LONG_ARRAY:
+						return QString::number(array->long_array_value()[index_node->array_index]);
+					default:
+						return "???";
+				}
+			}
+
 			switch (index_node->tag->type()) {
 				case nbt::TagType::BYTE:
 					return QString::number(index_node->tag->byte_value());
@@ -118,14 +159,13 @@ QVariant TagModel::data(const QModelIndex &index, int role) const {
 				case nbt::TagType::DOUBLE:
 					return QString::number(index_node->tag->double_value());
 				case nbt::TagType::STRING:
-					return index_node->tag->string_value();
+					return QString::fromStdString(std::string(index_node->tag->string_text()));
 				case nbt::TagType::BYTE_ARRAY:
 				case nbt::TagType::LIST:
+				case nbt::TagType::COMPOUND:
 				case nbt::TagType::INT_ARRAY:
 				case nbt::TagType::LONG_ARRAY:
-					return tr("[%1 tags]").arg(index_node->tag->list_value().length());
-				case nbt::TagType::COMPOUND:
-					return tr("[%1 tags]").arg(index_node->tag->compound_value().length());
+					return tr("[%1 tags]").arg(child_count(*index_node->tag));
 				default:
 					return "???";
 			}
@@ -159,13 +199,11 @@ QModelIndex TagModel::parent(const QModelIndex &child) const {
 		return createIndex(0, 0, root_node.get());
 
 	switch (grandparent_node->tag->type()) {
-		case nbt::TagType::BYTE_ARRAY:
 		case nbt::TagType::LIST:
-		case nbt::TagType::INT_ARRAY:
-		case nbt::TagType::LONG_ARRAY:
 			return createIndex(index_of_ptr(grandparent_node->tag->list_value(), parent_node->tag), 0, parent_node);
 		case nbt::TagType::COMPOUND:
-			return createIndex(index_of_ptr(grandparent_node->tag->compound_value(), parent_node->named_tag), 0, parent_node);
+			return createIndex(
+				index_of_ptr(grandparent_node->tag->compound_value(), parent_node->named_tag), 0, parent_node);
 		default:
 			return {};
 	}